@@ -12,8 +12,21 @@
 #include <stdio.h>
 #endif
 //-----------------------------------------------------------------------------
-const char * mrl_prompt_default     = MRL_PROMPT_DEFAULT;
-const int    mrl_prompt_default_len = MRL_PROMPT_DEFAULT_LEN;
+// no global variables: all state is in mrl_t object (one per session)
+static const char mrl_prompt_default[] = MRL_PROMPT_DEFAULT;
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_INDEX
+#define MRL_STR_(x) #x
+#define MRL_STR(x) MRL_STR_(x)
+#pragma message("MicroRL history index: " MRL_STR(MRL_HIST_INDEX_LEN) \
+                " x sizeof(" MRL_STR(MRL_HIST_INDEX_TYPE) ") bytes")
+#ifndef MRL_USE_EXT_BUF
+// history ring buffer offsets must fit to index type
+typedef char mrl_hist_index_check[
+  (MRL_HIST_INDEX_TYPE) (MRL_RING_HISTORY_LEN - 1) ==
+  MRL_RING_HISTORY_LEN - 1 ? 1 : -1];
+#endif // !MRL_USE_EXT_BUF
+#endif // MRL_USE_HIST_INDEX
 //-----------------------------------------------------------------------------
 #ifdef MRL_USE_HISTORY
 #ifdef MRL_DEBUG_HISTORY
@@ -22,30 +35,46 @@ const int    mrl_prompt_default_len = MRL_PROMPT_DEFAULT_LEN;
 // print buffer content on screen
 static void mrl_hist_print(const mrl_hist_t *self)
 {
+#ifdef MRL_USE_HIST_SHARED
+  const mrl_hist_shared_t *sh = self->shared;
+  const int len = MRL_RING_HISTORY_LEN;
+  const char *buf;
+  int begin, end, last, i;
+  if (sh == NULL) return;
+  buf   = sh->buf;
+  begin = sh->begin & (len - 1);
+  end   = sh->end   & (len - 1);
+  last  = sh->last  & (len - 1);
+#else
+  const char *buf = self->buf;
+  const int len = MRL_HIST_LEN(self);
+  const int begin = self->begin, end = self->end, last = self->last;
   int i;
-  for (i = 0; i < MRL_RING_HISTORY_LEN; i++)
-    printf("%c", i == self->begin ? 'B' : ' ');
+#endif // MRL_USE_HIST_SHARED
+
+  for (i = 0; i < len; i++)
+    printf("%c", i == begin ? 'B' : ' ');
 
   printf(MRL_ENDL);
-  for (i = 0; i < MRL_RING_HISTORY_LEN; i++)
+  for (i = 0; i < len; i++)
     printf("%c", i == self->cur ? 'C' : ' ');
 
   printf(MRL_ENDL);
-  for (i = 0; i < MRL_RING_HISTORY_LEN; i++)
+  for (i = 0; i < len; i++)
   {
-    if (self->buf[i] >= ' ')
-      printf("%c", self->buf[i]);
+    if (buf[i] >= ' ')
+      printf("%c", buf[i]);
     else
       printf(".");
   }
 
   printf(MRL_ENDL);
-  for (i = 0; i < MRL_RING_HISTORY_LEN; i++)
-    printf("%c", i == self->last ? 'L' : ' ');
+  for (i = 0; i < len; i++)
+    printf("%c", i == last ? 'L' : ' ');
 
   printf(MRL_ENDL);
-  for (i = 0; i < MRL_RING_HISTORY_LEN; i++)
-    printf("%c", i == self->end ? 'E' : ' ');
+  for (i = 0; i < len; i++)
+    printf("%c", i == end ? 'E' : ' ');
   
   printf(MRL_ENDL);
 }
@@ -54,7 +83,7 @@ static void mrl_cmd_print(const mrl_t *self)
 {
   int i;
   printf(MRL_ENDL "cmd=");
-  for (i = 0; i < MRL_COMMAND_LINE_LEN; i++)
+  for (i = 0; i < MRL_LINE_LEN(self); i++)
   {
     char c = self->cmdline[i];
     printf("%c", c >= ' ' ? c : c == '\0' ? '.' : '#');
@@ -63,26 +92,582 @@ static void mrl_cmd_print(const mrl_t *self)
 }
 #endif // MRL_DEBUG_HISTORY
 //-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_SHARED
+//-----------------------------------------------------------------------------
+// char of shared ring buffer by free running index
+#define MRL_HIST_AT(sh, i) ((sh)->buf[(i) & (MRL_RING_HISTORY_LEN - 1)])
+//-----------------------------------------------------------------------------
+// init history cursor
+static void mrl_hist_init(mrl_hist_t *self)
+{
+  self->shared = NULL; // history is off until mrl_hist_share()
+  self->pos    = 0;
+  self->cur    = -1;
+}
+//-----------------------------------------------------------------------------
+// save string to shared ring buffer (lines are saved by one object at
+// a time, other objects wait while line is copied)
+static bool mrl_hist_save(mrl_hist_t *self, const char *str)
+{
+  mrl_hist_shared_t *sh = self->shared;
+  unsigned seq, i, end, len;
+
+  // go out from history search mode
+  self->cur = -1;
+
+  // history is off
+  if (sh == NULL) return false;
+
+  // trim whitespaces on the begin
+  while (*str == ' ') str++;
+
+  // don't save empty string (and string longer than ring buffer)
+  len = strlen(str) + 1;
+  if (len == 1 || len > MRL_RING_HISTORY_LEN) return false;
+
+  // reserve ring buffer (odd sequence number), critical section is short
+  // (copy of one line), so wait for other writer
+  for (;;)
+  {
+    seq = MRL_SEQ_LOAD(&sh->seq);
+    if (!(seq & 1) && MRL_SEQ_CAS(&sh->seq, &seq, seq + 1)) break;
+    MRL_SEQ_PAUSE();
+  }
+
+  end = sh->end;
+  if (sh->last != end)
+  { // ring buffer not empty
+    const char *s = str;
+    for (i = sh->last; MRL_HIST_AT(sh, i) == *s; i++, s++)
+      if (*s == '\0')
+      { // don't save the same string
+        MRL_SEQ_STORE(&sh->seq, seq); // nothing is changed
+        return false;
+      }
+  }
+
+  // delete oldest lines
+  i = sh->begin;
+  while (end + len - i > MRL_RING_HISTORY_LEN)
+  {
+    while (MRL_HIST_AT(sh, i) != '\0') i++;
+    i++;
+  }
+  sh->begin = i;
+  MRL_SEQ_FENCE_REL(); // readers see new begin before overwritten chars
+
+  for (i = 0; i < len; i++)
+    MRL_HIST_AT(sh, end + i) = str[i];
+  self->saved = end;
+  sh->last = end;
+  sh->end  = end + len;
+
+  MRL_SEQ_STORE(&sh->seq, seq + 2); // release ring buffer
+  return true;
+}
+//-----------------------------------------------------------------------------
+// index of line before line at index i (i != begin)
+// [used inside mrl_hist_search() only]
+INLINE unsigned mrl_hist_prev(const mrl_hist_shared_t *sh, unsigned begin,
+                              unsigned i)
+{
+  i--; // '\0' of previous line
+  while (i != begin && MRL_HIST_AT(sh, i - 1) != '\0') i--;
+  return i;
+}
+//-----------------------------------------------------------------------------
+// index of line after line at index i (i != last)
+// [used inside mrl_hist_search() only]
+INLINE unsigned mrl_hist_next(const mrl_hist_shared_t *sh, unsigned end,
+                              unsigned i)
+{
+  while (i != end && MRL_HIST_AT(sh, i) != '\0') i++;
+  return i + 1;
+}
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_PREFIX
+// compare line at index i with prefix of string (without copying)
+// [used inside mrl_hist_search() only]
+INLINE bool mrl_hist_match(const mrl_hist_t *self, unsigned i,
+                           const char *str)
+{
+  int n = self->prefix;
+
+  while (n-- > 0 && *str != '\0')
+    if (MRL_HIST_AT(self->shared, i++) != *str++) return false;
+
+  return true;
+}
+#endif // MRL_USE_HIST_PREFIX
+//-----------------------------------------------------------------------------
+// search history (other objects may save lines at the same time)
+static int mrl_hist_search(mrl_hist_t *self, int dir, char *str)
+{
+  mrl_hist_shared_t *sh = self->shared;
+  unsigned seq, begin, end, last, pos;
+  bool enter = self->cur < 0, lost, ok;
+  int len, retry = 4;
+
+  if (sh == NULL) return -1; // history is off
+
+  if (enter)
+  { // enter to history search mode
+    if (dir == MRL_HIST_FORWARD || dir == MRL_HIST_LAST) return -1;
+    pos = sh->last;
+    if (pos == sh->end) return -1; // ring buffer empty
+    self->first_save = mrl_hist_save(self, str);
+    self->pos = pos; // newest line before saved line
+  }
+
+  do { // find line (lines are not copied, str may be prefix)
+    if (retry-- == 0) return -1; // ring buffer is changed too often
+    seq = MRL_SEQ_LOAD(&sh->seq);
+    if (seq & 1) return -1; // line is being saved now (try later)
+
+    begin = sh->begin;
+    end   = sh->end;
+    last  = sh->last;
+    pos   = self->pos;
+    lost  = (int) (pos - begin) < 0; // current line was deleted
+    if (lost) pos = begin;
+    ok = true;
+
+    if (dir == MRL_HIST_FIRST)
+      pos = begin;
+    else if (dir == MRL_HIST_LAST)
+    {
+      ok = self->first_save;
+      pos = ok && (int) (self->saved - begin) >= 0 ? self->saved : last;
+    }
+    else if (dir == MRL_HIST_BACKWARD)
+    {
+      if (!enter)
+      {
+        if (lost || pos == begin) return -1; // no oldest history
+        pos = mrl_hist_prev(sh, begin, pos);
+      }
+#ifdef MRL_USE_HIST_PREFIX
+      // skip lines which don't start with prefix
+      while (ok && !mrl_hist_match(self, pos, str))
+      {
+        ok = pos != begin;
+        if (ok) pos = mrl_hist_prev(sh, begin, pos);
+      }
+#endif // MRL_USE_HIST_PREFIX
+    }
+    else // dir == MRL_HIST_FORWARD
+    {
+      ok = lost || pos != last; // oldest line is next after deleted
+      if (ok && !lost) pos = mrl_hist_next(sh, end, pos);
+#ifdef MRL_USE_HIST_PREFIX
+      // skip lines which don't start with prefix (saved line is shown)
+      while (ok && !(self->first_save && pos == self->saved) &&
+             !mrl_hist_match(self, pos, str))
+      {
+        ok = pos != last;
+        if (ok) pos = mrl_hist_next(sh, end, pos);
+      }
+#endif // MRL_USE_HIST_PREFIX
+    }
+
+    MRL_SEQ_FENCE_ACQ();
+  } while (MRL_SEQ_LOAD(&sh->seq) != seq);
+
+  if (!ok)
+  {
+    if (dir == MRL_HIST_BACKWARD)
+    { // no oldest matched line, stay at previous line
+      if (enter && self->first_save)
+      { // saved line is current
+        self->pos = self->saved;
+        self->cur = self->saved & (MRL_RING_HISTORY_LEN - 1);
+      }
+      return -1;
+    }
+    if (!self->first_save)
+    { // no newest history: return empty string
+      self->cur = -1; // go out from history search mode
+      *str = '\0';
+      return 0;
+    }
+    return -1;
+  }
+
+  // copy line (cut to command line buffer size)
+  for (len = 0; len < self->line_len - 1; len++)
+    if ((str[len] = MRL_HIST_AT(sh, pos + len)) == '\0') break;
+  str[len] = '\0';
+
+  MRL_SEQ_FENCE_ACQ();
+  if ((int) (pos - sh->begin) < 0)
+  { // line was deleted while copying (return empty string)
+    self->cur = -1; // go out from history search mode
+    *str = '\0';
+    return 0;
+  }
+
+  self->pos = pos;
+  self->cur = pos & (MRL_RING_HISTORY_LEN - 1);
+  return len;
+}
+//-----------------------------------------------------------------------------
+#else // !MRL_USE_HIST_SHARED
 // init history ring buffer
 static void mrl_hist_init(mrl_hist_t *self)
 {
 #ifdef MRL_DEBUG_HISTORY
-  memset(self->buf, 0, MRL_RING_HISTORY_LEN);
+  memset(self->buf, 0, MRL_HIST_LEN(self));
 #endif // MRL_DEBUG_HISTORY
   self->begin = 0;
   self->end   = 0;
   self->last  = 0;
   self->cur   = -1;
+  if (MRL_HIST_LEN(self) > 0)
+    self->buf[MRL_HIST_LEN(self) - 1] = '\0'; // char before oldest line
+#ifdef MRL_USE_HIST_INDEX
+  self->first = 0;
+  self->count = 0;
+  self->n     = 0;
+#endif // MRL_USE_HIST_INDEX
+#ifdef MRL_USE_HIST_DEDUP
+  memset(self->hash, 0, sizeof(self->hash));
+  self->hashes = 0;
+#endif // MRL_USE_HIST_DEDUP
+#ifdef MRL_USE_HIST_SNAPSHOT
+  self->journal = NULL;
+#endif // MRL_USE_HIST_SNAPSHOT
+}
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_DEDUP
+// one step of line hash (FNV-1a)
+INLINE unsigned mrl_hash_step(unsigned hash, char ch)
+{
+  return (hash ^ (unsigned char) ch) * 16777619u;
+}
+//-----------------------------------------------------------------------------
+// fold line hash to table type (0 - free slot)
+INLINE MRL_HIST_DEDUP_TYPE mrl_hash_fold(unsigned hash)
+{
+  MRL_HIST_DEDUP_TYPE h = (MRL_HIST_DEDUP_TYPE) (hash ^ (hash >> 16));
+  return h != 0 ? h : 1;
+}
+//-----------------------------------------------------------------------------
+// hash of string
+static MRL_HIST_DEDUP_TYPE mrl_hash_str(const char *str)
+{
+  unsigned hash = 2166136261u;
+  while (*str != '\0')
+    hash = mrl_hash_step(hash, *str++);
+  return mrl_hash_fold(hash);
+}
+//-----------------------------------------------------------------------------
+// hash of history line begins at index i
+static MRL_HIST_DEDUP_TYPE mrl_hash_line(const mrl_hist_t *self, int i)
+{
+  unsigned hash = 2166136261u;
+  while (self->buf[i] != '\0')
+  {
+    hash = mrl_hash_step(hash, self->buf[i]);
+    if (++i == MRL_HIST_LEN(self)) i = 0;
+  }
+  return mrl_hash_fold(hash);
+}
+//-----------------------------------------------------------------------------
+// find hash in table (open addressing, linear probing), return slot or -1
+static int mrl_hash_find(const mrl_hist_t *self, MRL_HIST_DEDUP_TYPE h)
+{
+  int i = h & (MRL_HIST_DEDUP_LEN - 1);
+  while (self->hash[i] != 0)
+  {
+    if (self->hash[i] == h) return i;
+    i = (i + 1) & (MRL_HIST_DEDUP_LEN - 1);
+  }
+  return -1;
+}
+//-----------------------------------------------------------------------------
+// add hash to table (equal hashes of different lines are kept too)
+static void mrl_hash_add(mrl_hist_t *self, MRL_HIST_DEDUP_TYPE h)
+{
+  int i = h & (MRL_HIST_DEDUP_LEN - 1);
+  while (self->hash[i] != 0)
+    i = (i + 1) & (MRL_HIST_DEDUP_LEN - 1);
+  self->hash[i] = h;
+  self->hashes++;
+}
+//-----------------------------------------------------------------------------
+// delete one copy of hash from table (backward shift of next slots)
+static void mrl_hash_del(mrl_hist_t *self, MRL_HIST_DEDUP_TYPE h)
+{
+  int i = mrl_hash_find(self, h), j = i;
+  if (i < 0) return;
+
+  while (1)
+  {
+    int k;
+    j = (j + 1) & (MRL_HIST_DEDUP_LEN - 1);
+    if (self->hash[j] == 0) break;
+    k = self->hash[j] & (MRL_HIST_DEDUP_LEN - 1); // home slot
+    if (j > i ? (k <= i || k > j) : (k <= i && k > j))
+    { // hash from slot j may be moved to free slot i
+      self->hash[i] = self->hash[j];
+      i = j;
+    }
+  }
+  self->hash[i] = 0;
+  self->hashes--;
+}
+//-----------------------------------------------------------------------------
+// find line equal to string (return line index in buffer or -1)
+static int mrl_hist_find_line(const mrl_hist_t *self, const char *str)
+{
+  int i = self->begin;
+
+  while (i != self->end)
+  {
+    const char *s = str;
+    int j = i;
+
+    while (self->buf[j] == *s && *s != '\0')
+    {
+      s++;
+      if (++j == MRL_HIST_LEN(self)) j = 0;
+    }
+    if (self->buf[j] == *s) return i; // both are '\0'
+
+    while (self->buf[j] != '\0') // skip rest of line
+      if (++j == MRL_HIST_LEN(self)) j = 0;
+    if (++j == MRL_HIST_LEN(self)) j = 0;
+    i = j;
+  }
+
+  return -1;
+}
+//-----------------------------------------------------------------------------
+// delete line (not last) from history: oldest lines are moved to the hole
+static void mrl_hist_remove(mrl_hist_t *self, int pos, int len)
+{
+  int from = pos, to = pos + len;
+  if (to >= MRL_HIST_LEN(self)) to -= MRL_HIST_LEN(self);
+
+  while (from != self->begin)
+  {
+    if (--from < 0) from += MRL_HIST_LEN(self);
+    if (--to   < 0) to   += MRL_HIST_LEN(self);
+    self->buf[to] = self->buf[from];
+  }
+  self->begin = to;
+  self->buf[(to ? to : MRL_HIST_LEN(self)) - 1] = '\0'; // before oldest line
+
+#ifdef MRL_USE_HIST_INDEX
+  { // delete line from index, oldest lines are moved by len
+    int n = 0;
+    while (MRL_HIST_IDX(self, n) != pos) n++;
+    for (; n > 0; n--)
+    {
+      to = MRL_HIST_IDX(self, n - 1) + len;
+      if (to >= MRL_HIST_LEN(self)) to -= MRL_HIST_LEN(self);
+      MRL_HIST_IDX(self, n) = to;
+    }
+    self->first = (self->first + 1) & (MRL_HIST_INDEX_LEN - 1);
+    self->count--;
+  }
+#endif // MRL_USE_HIST_INDEX
+}
+#endif // MRL_USE_HIST_DEDUP
+//-----------------------------------------------------------------------------
+// delete oldest line from history
+static void mrl_hist_drop(mrl_hist_t *self)
+{
+#ifdef MRL_USE_HIST_DEDUP
+  mrl_hash_del(self, mrl_hash_line(self, self->begin));
+#endif // MRL_USE_HIST_DEDUP
+
+#ifdef MRL_USE_HIST_INDEX
+  self->first = (self->first + 1) & (MRL_HIST_INDEX_LEN - 1);
+  self->begin = --self->count ? MRL_HIST_IDX(self, 0) : self->end;
+#else
+  do {
+    if (++self->begin == MRL_HIST_LEN(self)) self->begin = 0;
+  } while (self->buf[self->begin] != '\0');
+  if (++self->begin == MRL_HIST_LEN(self)) self->begin = 0;
+#endif // MRL_USE_HIST_INDEX
+}
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_FRONT
+// front-coded line in ring buffer: char (prefix + 1), suffix, '\0', where
+// prefix - length of begin shared with next (newer) line (newest line has
+// empty prefix), so chars of line never are '\0'
+//-----------------------------------------------------------------------------
+// length of front-coded line at index i of ring buffer
+static int mrl_front_len(const char *ring, int size, int i)
+{
+  int len = (unsigned char) ring[i] - 1;
+
+  if (++i == size) i = 0;
+  while (ring[i] != '\0')
+  {
+    if (++i == size) i = 0;
+    len++;
+  }
+
+  return len;
+}
+//-----------------------------------------------------------------------------
+// get n chars of front-coded line at index i to buf or compare them with str
+// (if buf is NULL), chars of shared prefix are taken from newer lines
+// (return false if chars are different)
+static bool mrl_front_get(const char *ring, int size, int i, int n,
+                          char *buf, const char *str)
+{
+  while (n > 0)
+  {
+    int j, prefix = (unsigned char) ring[i] - 1;
+    if (++i == size) i = 0;
+
+    for (j = prefix; j < n; j++)
+    { // suffix chars
+      if (buf != NULL)
+        buf[j] = ring[i];
+      else if (str[j] != ring[i])
+        return false;
+      if (++i == size) i = 0;
+    }
+    if (prefix < n) n = prefix;
+
+    // go to next (newer) line
+    while (ring[i] != '\0')
+      if (++i == size) i = 0;
+    if (++i == size) i = 0;
+  }
+
+  return true;
+}
+//-----------------------------------------------------------------------------
+// code last line by length of prefix shared with next saved line
+static void mrl_front_code(mrl_hist_t *self, int prefix)
+{
+  int i = self->last, j;
+  char ch;
+
+  if (prefix > 254) prefix = 254; // prefix + 1 must fit to char
+  if (prefix == 0) return;
+
+  self->buf[i] = (char) (prefix + 1);
+  if (++i == MRL_HIST_LEN(self)) i = 0;
+  j = i + prefix;
+  if (j >= MRL_HIST_LEN(self)) j -= MRL_HIST_LEN(self);
+
+  do { // move suffix
+    ch = self->buf[j];
+    self->buf[i] = ch;
+    if (++i == MRL_HIST_LEN(self)) i = 0;
+    if (++j == MRL_HIST_LEN(self)) j = 0;
+  } while (ch != '\0');
+
+  self->end = i;
+}
+#endif // MRL_USE_HIST_FRONT
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_SNAPSHOT
+// Adler-32 checksum (start from 1)
+static uint32_t mrl_adler32(uint32_t sum, const void *buf, int len)
+{
+  const unsigned char *ptr = (const unsigned char*) buf;
+  uint32_t a = sum & 0xFFFF, b = sum >> 16;
+
+  while (len > 0)
+  {
+    int n = len < 5552 ? len : 5552; // no overflow before modulo
+    len -= n;
+    while (n-- > 0)
+    {
+      a += *ptr++;
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+
+  return (b << 16) | a;
+}
+//-----------------------------------------------------------------------------
+// copy and check snapshot header (without checksum)
+static bool mrl_snap_header(const void *snap, int size, mrl_snap_t *hdr)
+{
+  const char *ring = (const char*) snap + sizeof(mrl_snap_t);
+
+  if (snap == NULL || size < (int) sizeof(mrl_snap_t)) return false;
+  memcpy(hdr, snap, sizeof(mrl_snap_t)); // snapshot may be unaligned
+
+  if (hdr->magic != MRL_SNAP_MAGIC || hdr->version != MRL_SNAP_VERSION ||
+      hdr->len == 0 || hdr->len > (uint32_t) size - sizeof(mrl_snap_t) ||
+      hdr->begin >= hdr->len || hdr->end >= hdr->len || hdr->last >= hdr->len)
+    return false;
+
+  // last line must be terminated (all lines search stops at '\0')
+  if (hdr->last != hdr->end &&
+      ring[(hdr->end ? hdr->end : hdr->len) - 1] != '\0')
+    return false;
+
+  return true;
+}
+//-----------------------------------------------------------------------------
+// make index and hashes table of lines in restored ring buffer
+static void mrl_hist_rebuild(mrl_hist_t *self)
+{
+  self->cur = -1;
+  if (self->last != self->end) // char before oldest line (end of free space)
+    self->buf[(self->begin ? self->begin : MRL_HIST_LEN(self)) - 1] = '\0';
+#if defined(MRL_USE_HIST_INDEX) || defined(MRL_USE_HIST_DEDUP)
+  {
+    int i = self->last != self->end ? self->begin : self->end;
+#ifdef MRL_USE_HIST_INDEX
+    self->first = 0;
+    self->count = 0;
+#endif // MRL_USE_HIST_INDEX
+#ifdef MRL_USE_HIST_DEDUP
+    memset(self->hash, 0, sizeof(self->hash));
+    self->hashes = 0;
+#endif // MRL_USE_HIST_DEDUP
+
+    while (i != self->end)
+    {
+#ifdef MRL_USE_HIST_DEDUP
+      if (self->hashes == MRL_HIST_DEDUP_LEN - 1)
+        mrl_hist_drop(self); // hashes table is full
+      mrl_hash_add(self, mrl_hash_line(self, i));
+#endif // MRL_USE_HIST_DEDUP
+#ifdef MRL_USE_HIST_INDEX
+      if (self->count == MRL_HIST_INDEX_LEN)
+        mrl_hist_drop(self); // index is full
+      MRL_HIST_IDX(self, self->count++) = i;
+#endif // MRL_USE_HIST_INDEX
+
+      while (self->buf[i] != '\0') // go to next line
+        if (++i == MRL_HIST_LEN(self)) i = 0;
+      if (++i == MRL_HIST_LEN(self)) i = 0;
+    }
+  }
+#endif // MRL_USE_HIST_INDEX || MRL_USE_HIST_DEDUP
 }
+#endif // MRL_USE_HIST_SNAPSHOT
 //-----------------------------------------------------------------------------
 // save string to ring buffer
 static bool mrl_hist_save(mrl_hist_t *self, const char *str)
 {
   char ch;
+#ifdef MRL_USE_HIST_DEDUP
+  MRL_HIST_DEDUP_TYPE h;
+#endif // MRL_USE_HIST_DEDUP
   
   // go out from history search mode
   self->cur = -1;
 
+#ifdef MRL_USE_EXT_BUF
+  // history is off
+  if (self->len == 0) return false;
+#endif // MRL_USE_EXT_BUF
+
   // trim whitespaces on the begin
   while (*str == ' ') str++;
 
@@ -92,30 +677,68 @@ static bool mrl_hist_save(mrl_hist_t *self, const char *str)
   if (self->last != self->end)
   { // ring buffer not empty
     int i = self->last, j = 0;
+#ifdef MRL_USE_HIST_FRONT
+    if (++i == MRL_HIST_LEN(self)) i = 0; // skip prefix of newest line
+#endif // MRL_USE_HIST_FRONT
     while (1)
     {
       ch = str[j++];
       if (ch != self->buf[i]) break;
       if (ch == '\0')
         return false; // don't save the same string
-      if (++i == MRL_RING_HISTORY_LEN) i = 0;
+      if (++i == MRL_HIST_LEN(self)) i = 0;
     }
+#ifdef MRL_USE_HIST_FRONT
+    mrl_front_code(self, j - 1); // j - 1 chars are shared with saved line
+#endif // MRL_USE_HIST_FRONT
   }
   
+#ifdef MRL_USE_HIST_DEDUP
+  h = mrl_hash_str(str);
+  if (mrl_hash_find(self, h) >= 0)
+  { // may be identical line is in history (move it to front)
+    int pos = mrl_hist_find_line(self, str);
+    if (pos >= 0)
+    {
+      mrl_hist_remove(self, pos, strlen(str) + 1);
+      mrl_hash_del(self, h);
+    }
+  }
+  if (self->hashes == MRL_HIST_DEDUP_LEN - 1)
+    mrl_hist_drop(self); // hashes table is full
+#endif // MRL_USE_HIST_DEDUP
+
+#ifdef MRL_USE_HIST_SNAPSHOT
+  if (self->journal != NULL)
+    self->journal(self->ctx, str); // append line to journal
+#endif // MRL_USE_HIST_SNAPSHOT
+
   self->last = self->end;
+#ifdef MRL_USE_HIST_INDEX
+  if (self->count == MRL_HIST_INDEX_LEN)
+    mrl_hist_drop(self); // index is full
+  MRL_HIST_IDX(self, self->count++) = self->end;
+#endif // MRL_USE_HIST_INDEX
+
+#ifdef MRL_USE_HIST_FRONT
+  self->buf[self->end] = 1; // empty prefix (newest line is not coded)
+  if (++self->end == MRL_HIST_LEN(self)) self->end = 0;
+  if (self->end == self->begin)
+    mrl_hist_drop(self);
+#endif // MRL_USE_HIST_FRONT
+
   do {
     ch = *str++;
     self->buf[self->end++] = ch;
-    if (self->end == MRL_RING_HISTORY_LEN) self->end = 0;
+    if (self->end == MRL_HIST_LEN(self)) self->end = 0;
     if (self->end == self->begin)
-    { // delete from history olderest string
-      do {
-        if (++self->begin == MRL_RING_HISTORY_LEN) self->begin = 0;
-      } while (self->buf[self->begin] != '\0');
-      if (++self->begin == MRL_RING_HISTORY_LEN) self->begin = 0;
-    }
+      mrl_hist_drop(self); // delete from history olderest string
   } while (ch != '\0');
 
+#ifdef MRL_USE_HIST_DEDUP
+  mrl_hash_add(self, h);
+#endif // MRL_USE_HIST_DEDUP
+
   return true;
 }
 //-----------------------------------------------------------------------------
@@ -123,19 +746,25 @@ static bool mrl_hist_save(mrl_hist_t *self, const char *str)
 // [used inside mrl_hist_search() only]
 INLINE bool mrl_hist_backward(mrl_hist_t *self)
 {
+#ifdef MRL_USE_HIST_INDEX
+  if (self->n == 0) return false; // already at the begin
+  self->cur = MRL_HIST_IDX(self, --self->n);
+  return true;
+#else
   int i;
   if (self->cur == self->begin) return false; // already at the begin
    
   i = self->cur - 2;
-  if (i < 0) i += MRL_RING_HISTORY_LEN;
+  if (i < 0) i += MRL_HIST_LEN(self);
 
   while (self->buf[i] != '\0')
-    if (--i < 0) i += MRL_RING_HISTORY_LEN; 
+    if (--i < 0) i += MRL_HIST_LEN(self); 
 
-  if (++i == MRL_RING_HISTORY_LEN) i = 0;
+  if (++i == MRL_HIST_LEN(self)) i = 0;
   self->cur = i;
 
   return true;
+#endif // MRL_USE_HIST_INDEX
 }
 //-----------------------------------------------------------------------------
 // forward history
@@ -144,10 +773,14 @@ INLINE bool mrl_hist_forward(mrl_hist_t *self)
 {
   if (self->cur == self->last) return false; // already at the end
 
+#ifdef MRL_USE_HIST_INDEX
+  self->cur = MRL_HIST_IDX(self, ++self->n);
+#else
   while (self->buf[self->cur] != '\0')
-    if (++self->cur == MRL_RING_HISTORY_LEN) self->cur = 0;
+    if (++self->cur == MRL_HIST_LEN(self)) self->cur = 0;
 
-  if (++self->cur == MRL_RING_HISTORY_LEN) self->cur = 0;
+  if (++self->cur == MRL_HIST_LEN(self)) self->cur = 0;
+#endif // MRL_USE_HIST_INDEX
 
   return true;
 }
@@ -156,38 +789,144 @@ INLINE bool mrl_hist_forward(mrl_hist_t *self)
 // [used inside mrl_hist_search() only]
 INLINE int mrl_hist_get(const mrl_hist_t *self, char *buf)
 {
+#ifdef MRL_USE_HIST_FRONT
+  int len = mrl_front_len(self->buf, MRL_HIST_LEN(self), self->cur);
+  mrl_front_get(self->buf, MRL_HIST_LEN(self), self->cur, len, buf, NULL);
+  buf[len] = '\0';
+#else
   int len = 0, i = self->cur;
     
   while ((*buf++ = self->buf[i]) != '\0')
   {
-    if (++i == MRL_RING_HISTORY_LEN) i = 0;
+    if (++i == MRL_HIST_LEN(self)) i = 0;
     len++;
   }
+#endif // MRL_USE_HIST_FRONT
 
   return len;
 }
 //-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_PREFIX
+// compare current history line with prefix of string (without copying)
+// [used inside mrl_hist_search() only]
+INLINE bool mrl_hist_match(const mrl_hist_t *self, const char *str)
+{
+#ifdef MRL_USE_HIST_FRONT
+  int n = 0;
+  while (n < self->prefix && str[n] != '\0') n++;
+
+  return n <= mrl_front_len(self->buf, MRL_HIST_LEN(self), self->cur) &&
+         mrl_front_get(self->buf, MRL_HIST_LEN(self), self->cur, n,
+                       NULL, str);
+#else
+  int i = self->cur, n = self->prefix;
+
+  while (n-- > 0 && *str != '\0')
+  {
+    if (self->buf[i] != *str++) return false;
+    if (++i == MRL_HIST_LEN(self)) i = 0;
+  }
+
+  return true;
+#endif // MRL_USE_HIST_FRONT
+}
+#endif // MRL_USE_HIST_PREFIX
+//-----------------------------------------------------------------------------
 // search history
 static int mrl_hist_search(mrl_hist_t *self, int dir, char *str)
 {
+#ifdef MRL_USE_HIST_PREFIX
+  int prev = self->cur; // for return to previous line
+#ifdef MRL_USE_HIST_INDEX
+  int n = self->n;
+#endif // MRL_USE_HIST_INDEX
+#endif // MRL_USE_HIST_PREFIX
+
   if (self->last == self->end) return -1; // ring buffer empty
 
-  if (dir == MRL_HIST_BACKWARD)
+  if (dir == MRL_HIST_BACKWARD || dir == MRL_HIST_FIRST)
   {
     if (self->cur < 0)
     { // enter to history search mode
       int cur = self->last;
       self->first_save = mrl_hist_save(self, str);
       self->cur = cur;
+#ifdef MRL_USE_HIST_INDEX
+      self->n = self->count - (self->first_save ? 2 : 1);
+      if (self->n < 0)
+      { // last line was deleted by saved line
+        self->n   = 0;
+        self->cur = self->begin;
+      }
+#endif // MRL_USE_HIST_INDEX
+    }
+    else if (dir == MRL_HIST_BACKWARD)
+    {
+      if (!mrl_hist_backward(self)) return -1; // no oldest history
+    }
+
+#ifdef MRL_USE_HIST_PREFIX
+    // skip lines which don't start with prefix
+    if (dir == MRL_HIST_BACKWARD)
+    {
+      while (!mrl_hist_match(self, str))
+      {
+        if (!mrl_hist_backward(self))
+        { // no oldest matched line, stay at previous line
+          if (prev >= 0)
+          {
+            self->cur = prev;
+#ifdef MRL_USE_HIST_INDEX
+            self->n = n;
+#endif // MRL_USE_HIST_INDEX
+          }
+          else if (self->first_save)
+          { // saved line is current
+            self->cur = self->last;
+#ifdef MRL_USE_HIST_INDEX
+            self->n = self->count - 1;
+#endif // MRL_USE_HIST_INDEX
+          }
+          else
+            self->cur = -1; // go out from history search mode
+          return -1;
+        }
+      }
+    }
+#endif // MRL_USE_HIST_PREFIX
+
+    if (dir == MRL_HIST_FIRST)
+    {
+      self->cur = self->begin;
+#ifdef MRL_USE_HIST_INDEX
+      self->n = 0;
+#endif // MRL_USE_HIST_INDEX
     }
-    else
-      if (!mrl_hist_backward(self)) return -1; // no olderst history
   }
-  else // dir == MRL_HIST_FORWARD
+  else // dir == MRL_HIST_FORWARD || dir == MRL_HIST_LAST
   {
+    bool ok;
     if (self->cur < 0) return -1; // no history search mode
-    if (!mrl_hist_forward(self))
-    { // no newrest history
+    if (dir == MRL_HIST_LAST)
+    {
+      self->cur = self->last;
+#ifdef MRL_USE_HIST_INDEX
+      self->n = self->count - 1;
+#endif // MRL_USE_HIST_INDEX
+      ok = self->first_save;
+    }
+    else
+    {
+      ok = mrl_hist_forward(self);
+#ifdef MRL_USE_HIST_PREFIX
+      // skip lines which don't start with prefix (saved line is shown)
+      while (ok && !(self->first_save && self->cur == self->last) &&
+             !mrl_hist_match(self, str))
+        ok = mrl_hist_forward(self);
+#endif // MRL_USE_HIST_PREFIX
+    }
+    if (!ok)
+    { // no newest history
       if (!self->first_save)
       { // return empty string
         self->cur = -1; // go out from history search mode
@@ -200,83 +939,474 @@ static int mrl_hist_search(mrl_hist_t *self, int dir, char *str)
 
   return mrl_hist_get(self, str);
 }
+#endif // MRL_USE_HIST_SHARED
 //-----------------------------------------------------------------------------
-#endif // MRL_USE_HISTORY
+#ifdef MRL_USE_HIST_SEARCH
+// number of used chars in ring buffer
+INLINE int mrl_hist_used(const mrl_hist_t *self)
+{
+  int used = self->end - self->begin;
+  return used < 0 ? used + MRL_HIST_LEN(self) : used;
+}
 //-----------------------------------------------------------------------------
-INLINE void mrl_terminal_prompt(const mrl_t *self)
+// ring buffer index by position (0 - begin of oldest line)
+INLINE int mrl_hist_at(const mrl_hist_t *self, int pos)
 {
-  self->print(self->prompt);
+  pos += self->begin;
+  return pos < MRL_HIST_LEN(self) ? pos : pos - MRL_HIST_LEN(self);
 }
 //-----------------------------------------------------------------------------
-INLINE void mrl_terminal_print(const mrl_t *self, const char *str)
+// begin position of line contains position pos
+static int mrl_hist_line_begin(const mrl_hist_t *self, int pos)
 {
-#ifndef MRL_PRINT_ESC_OFF
-  self->print("\033[K"); // delete all from cursor to end
-#endif // MRL_PRINT_ESC_OFF
-  self->print(str);
+  while (pos > 0 && self->buf[mrl_hist_at(self, pos - 1)] != '\0')
+    pos--;
+  return pos;
 }
 //-----------------------------------------------------------------------------
-INLINE void mrl_terminal_newline(const mrl_t *self)
+// end position ('\0') of line contains position pos
+static int mrl_hist_line_end(const mrl_hist_t *self, int pos)
 {
-  self->print(MRL_ENDL);
+  while (self->buf[mrl_hist_at(self, pos)] != '\0')
+    pos++;
+  return pos;
 }
 //-----------------------------------------------------------------------------
-// set cursor position after prompt
-static void mrl_terminal_cursor(const mrl_t *self, int cursor)
+// find last string (len > 0) which ends before position 'to' and return
+// it position or -1 (string can't contain '\0', so it is inside one line,
+// but line may wrap around end of ring buffer)
+static int mrl_hist_find(const mrl_hist_t *self, const char *str, int len,
+                         int to)
 {
-#ifndef MRL_PRINT_ESC_OFF
-  char str[16];
-  cursor += self->prompt_len;
-#ifdef MRL_USE_LIBC_STDIO
-  if (cursor == 0) strcpy(str, "\r");
-  else snprintf(str, sizeof(str) - 1, "\r\033[%iC", cursor);
-  //else snprintf(str, sizeof(str) - 1, "\033[%iG", cursor + 1);
-#else
-  char *ptr = str;
-  *ptr++ = '\r';
-  if (cursor)
+  int pos = to - len;
+
+  while (pos >= 0)
   {
-    *ptr++ = '\033';
-    *ptr++ = '[';
-     ptr  += mrl_uint2str(cursor, ptr);
-    *ptr++ = 'C';
-  }
-  *ptr  = '\0';
-#endif // MRL_USE_LIBC_STDIO
-  self->print(str);
+    int i = mrl_hist_at(self, pos), j = i;
+    int lo = i >= self->begin ? self->begin : 0; // begin of contiguous part
 
-#else // MRL_PRINT_ESC_OFF
+    // fast scan for first char
+    while (j >= lo && self->buf[j] != *str) j--;
+    pos -= i - j;
+    if (j < lo) continue; // go to previous part of ring buffer
+
+    for (i = 1; i < len; i++)
+      if (self->buf[mrl_hist_at(self, pos + i)] != str[i]) break;
+    if (i == len) return pos;
+
+    pos--;
+  }
+
+  return -1;
+}
+#endif // MRL_USE_HIST_SEARCH
+//-----------------------------------------------------------------------------
+#endif // MRL_USE_HISTORY
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_OUTBUF
+void mrl_flush(mrl_t *self)
+{
+  if (self->outlen)
+  {
+    self->outbuf[self->outlen] = '\0';
+    self->outlen = 0;
+    self->print(self->ctx, self->outbuf);
+  }
+}
+#endif // MRL_USE_OUTBUF
+//-----------------------------------------------------------------------------
+// put string to terminal (via output buffer if used)
+static void mrl_print(mrl_t *self, const char *str)
+{
+#ifdef MRL_USE_OUTBUF
+  while (*str != '\0')
+  {
+    if (self->outlen == MRL_OUTBUF_LEN - 1) mrl_flush(self);
+    self->outbuf[self->outlen++] = *str++;
+  }
+#else
+  self->print(self->ctx, str);
+#endif // MRL_USE_OUTBUF
+}
+//-----------------------------------------------------------------------------
+// flush output buffer at the end of API call
+INLINE void mrl_auto_flush(mrl_t *self)
+{
+#if defined(MRL_USE_OUTBUF) && !defined(MRL_OUTBUF_MANUAL_FLUSH)
+  mrl_flush(self);
+#else
+  (void) self;
+#endif
+}
+//-----------------------------------------------------------------------------
+INLINE void mrl_terminal_prompt(mrl_t *self)
+{
+  mrl_print(self, self->prompt);
+  self->tpos = 0;
+}
+//-----------------------------------------------------------------------------
+// print tail of command line (from 'str' to end)
+INLINE void mrl_terminal_print(mrl_t *self, const char *str)
+{
+#ifndef MRL_PRINT_ESC_OFF
+  mrl_print(self, "\033[K"); // delete all from cursor to end
+#endif // MRL_PRINT_ESC_OFF
+  mrl_print(self, str);
+  self->tpos = self->cmdlen;
+}
+//-----------------------------------------------------------------------------
+// print 'n' spaces (erase old chars without ESC sequence)
+INLINE void mrl_terminal_spaces(mrl_t *self, int n)
+{
+  self->tpos += n;
+  while (n-- > 0)
+    mrl_print(self, " ");
+}
+//-----------------------------------------------------------------------------
+INLINE void mrl_terminal_newline(mrl_t *self)
+{
+  mrl_print(self, MRL_ENDL);
+  self->tpos = MRL_TPOS_UNKNOWN;
+}
+//-----------------------------------------------------------------------------
+// erase all line and go to begin
+INLINE void mrl_terminal_clear(mrl_t *self)
+{
+#ifndef MRL_PRINT_ESC_OFF
+  mrl_print(self, "\r\033[K");
+#else
+  mrl_print(self, "\r"); // FIXME
+#endif // MRL_PRINT_ESC_OFF
+  self->tpos = MRL_TPOS_UNKNOWN;
+}
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_SHADOW
+// terminal show all command line and cursor set (after full reprint)
+INLINE void mrl_shadow_sync(mrl_t *self)
+{
+  if (MRL_SHADOW_ON(self))
+    memcpy(self->shadow, self->cmdline, self->cmdlen);
+  self->slen = self->cmdlen;
+  self->tpos = self->cursor;
+}
+//-----------------------------------------------------------------------------
+// terminal show only prompt and cursor after it
+INLINE void mrl_shadow_reset(mrl_t *self)
+{
+  self->slen = self->tpos = 0;
+}
+//-----------------------------------------------------------------------------
+// command line chars from 'from' to 'to' reprinted on terminal
+INLINE void mrl_shadow_put(mrl_t *self, int from, int to)
+{
+  if (MRL_SHADOW_ON(self))
+    memcpy(self->shadow + from, self->cmdline + from, to - from);
+  if (self->slen < to) self->slen = to;
+}
+#endif // MRL_USE_SHADOW
+//-----------------------------------------------------------------------------
+#ifndef MRL_PRINT_ESC_OFF
+// print CSI sequence "ESC[<n><cmd>" (n=1 is default and omitted)
+static void mrl_terminal_csi(mrl_t *self, int n, char cmd)
+{
+  char str[16];
+#ifdef MRL_USE_LIBC_STDIO
+  if (n == 1) snprintf(str, sizeof(str) - 1, "\033[%c", cmd);
+  else        snprintf(str, sizeof(str) - 1, "\033[%i%c", n, cmd);
+#else
+  char *ptr = str;
+  *ptr++ = '\033';
+  *ptr++ = '[';
+  if (n != 1)
+    ptr += mrl_uint2str(n, ptr);
+  *ptr++ = cmd;
+  *ptr   = '\0';
+#endif // MRL_USE_LIBC_STDIO
+  mrl_print(self, str);
+}
+//-----------------------------------------------------------------------------
+#ifndef MRL_ECHO_OFF
+// length of CSI sequence "ESC[<n><cmd>"
+static int mrl_csi_len(int n)
+{
+  int len = 3;
+  if (n != 1)
+    do { len++; } while (n /= 10);
+  return len;
+}
+#endif // !MRL_ECHO_OFF
+#endif // !MRL_PRINT_ESC_OFF
+//-----------------------------------------------------------------------------
+// set cursor position after prompt by CR and move right (ESC[nC) or by
+// reprint prompt and command line if ESC sequences are off
+static void mrl_terminal_cursor_abs(mrl_t *self, int cursor)
+{
+#ifndef MRL_PRINT_ESC_OFF
+  mrl_print(self, "\r");
+  if (cursor + self->prompt_len)
+    mrl_terminal_csi(self, cursor + self->prompt_len, 'C');
+
+#else // MRL_PRINT_ESC_OFF
   int i;
   char tmp[2];
   tmp[1] = '\0';
-  self->print("\r");
+  mrl_print(self, "\r");
   mrl_terminal_prompt(self);
   for (i = 0; i < self->cmdlen && i < cursor; i++)
   {
     tmp[0] = self->cmdline[i];
-    self->print(tmp);
+    mrl_print(self, tmp);
   }
   for (; i < cursor; i++)
-    self->print(" ");
+    mrl_print(self, " ");
+#ifdef MRL_USE_SHADOW
+  mrl_shadow_put(self, 0, cursor < self->cmdlen ? cursor : self->cmdlen);
+#endif // MRL_USE_SHADOW
 #endif // MRL_PRINT_ESC_OFF
+  self->tpos = cursor;
 }
 //-----------------------------------------------------------------------------
-INLINE void mrl_terminal_cursor_back(const mrl_t *self)
+#ifndef MRL_ECHO_OFF
+// reprint command line chars from terminal cursor to 'cursor'
+static void mrl_terminal_rewrite(mrl_t *self, int cursor)
+{
+  char ch = self->cmdline[cursor];
+  self->cmdline[cursor] = '\0';
+  mrl_print(self, self->cmdline + self->tpos);
+  self->cmdline[cursor] = ch;
+#ifdef MRL_USE_SHADOW
+  mrl_shadow_put(self, self->tpos, cursor);
+#endif // MRL_USE_SHADOW
+  self->tpos = cursor;
+}
+#endif // !MRL_ECHO_OFF
+//-----------------------------------------------------------------------------
+// set cursor position after prompt
+// (select the shortest way from known terminal cursor position, count bytes)
+static void mrl_terminal_cursor(mrl_t *self, int cursor)
 {
+#ifndef MRL_ECHO_OFF
+  int way, cost, d = cursor - self->tpos;
+#ifndef MRL_PRINT_ESC_OFF
+  int col = cursor + self->prompt_len; // 0..N
+
+  way  = MRL_MOVE_ABS; // CR + ESC[nC
+  cost = col ? 1 + mrl_csi_len(col) : 1;
+#ifdef MRL_USE_CHA
+  if (mrl_csi_len(col + 1) < cost)
+  { // ESC[nG
+    way  = MRL_MOVE_CHA;
+    cost = mrl_csi_len(col + 1);
+  }
+#endif // MRL_USE_CHA
+#else // MRL_PRINT_ESC_OFF
+  way  = MRL_MOVE_ABS; // CR + prompt + command line
+  cost = 1 + strlen(self->prompt) + cursor;
+#endif // MRL_PRINT_ESC_OFF
+
+  if (self->tpos != MRL_TPOS_UNKNOWN)
+  {
+    if (d == 0) return; // nothing to do
+
+    if (d < 0)
+    { // move left
+      if (-d <= cost)
+      { // '\b' x N
+        way  = MRL_MOVE_BS;
+        cost = -d;
+      }
+#ifndef MRL_PRINT_ESC_OFF
+      if (mrl_csi_len(-d) < cost)
+        way = MRL_MOVE_CUB; // ESC[nD
+#endif // !MRL_PRINT_ESC_OFF
+    }
+    else
+    { // move right
+      if (d <= cost)
+      { // reprint known chars
+        way  = MRL_MOVE_REWRITE;
+        cost = d;
+      }
+#ifndef MRL_PRINT_ESC_OFF
+      if (mrl_csi_len(d) < cost)
+        way = MRL_MOVE_CUF; // ESC[nC
+#endif // !MRL_PRINT_ESC_OFF
+    }
+  }
+
+  switch (way)
+  {
+    case MRL_MOVE_BS:
+      while (d++ < 0)
+        mrl_print(self, "\b");
+      break;
+
+    case MRL_MOVE_REWRITE:
+      mrl_terminal_rewrite(self, cursor);
+      break;
+
 #ifndef MRL_PRINT_ESC_OFF
-  self->print("\033[D");
+    case MRL_MOVE_CUB:
+      mrl_terminal_csi(self, -d, 'D');
+      break;
+
+    case MRL_MOVE_CUF:
+      mrl_terminal_csi(self, d, 'C');
+      break;
+
+#ifdef MRL_USE_CHA
+    case MRL_MOVE_CHA:
+      mrl_terminal_csi(self, col + 1, 'G');
+      break;
+#endif // MRL_USE_CHA
+#endif // !MRL_PRINT_ESC_OFF
+
+    default: // MRL_MOVE_ABS
+      mrl_terminal_cursor_abs(self, cursor);
+  }
+  self->tpos = cursor;
+
+#else // MRL_ECHO_OFF
+  mrl_terminal_cursor_abs(self, cursor);
+#endif // MRL_ECHO_OFF
+}
+//-----------------------------------------------------------------------------
+INLINE void mrl_terminal_cursor_back(mrl_t *self)
+{
+#if !defined(MRL_PRINT_ESC_OFF) && defined(MRL_ECHO_OFF)
+  mrl_print(self, "\033[D");
 #else
   mrl_terminal_cursor(self, self->cursor - 1);
-#endif // MRL_PRINT_ESC_OFF
+#endif
 }
 //-----------------------------------------------------------------------------
-INLINE void mrl_terminal_cursor_forward(const mrl_t *self)
+INLINE void mrl_terminal_cursor_forward(mrl_t *self)
 {
-#ifndef MRL_PRINT_ESC_OFF
-  self->print("\033[C");
+#if !defined(MRL_PRINT_ESC_OFF) && defined(MRL_ECHO_OFF)
+  mrl_print(self, "\033[C");
 #else
   mrl_terminal_cursor(self, self->cursor + 1);
+#endif
+}
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_SHADOW
+// show command line and cursor by sending only changed chars
+// (compare command line with shadow copy of terminal content)
+static void mrl_render(mrl_t *self)
+{
+  char *cmd = self->cmdline, *sh = self->shadow;
+  int i = 0, n = self->cmdlen;
+  int m = n < self->slen ? n : self->slen; // aligned compare limit
+
+  if (!MRL_SHADOW_ON(self))
+    m = 0; // no shadow buffer: reprint all command line
+
+  while (1)
+  {
+    int j, k;
+    char ch;
+
+    // skip unchanged chars
+    while (i < m && cmd[i] == sh[i]) i++;
+    if (i >= n) break;
+
+    // find end of changed chars (short unchanged gaps reprinted)
+    j = i;
+    while (1)
+    {
+      while (j < n && (j >= m || cmd[j] != sh[j])) j++;
+      k = j;
+      while (k < m && cmd[k] == sh[k]) k++;
+      if (k >= n || k - j > MRL_SHADOW_GAP) break;
+      j = k;
+    }
+
+    mrl_terminal_cursor(self, i);
+    ch = cmd[j];
+    cmd[j] = '\0';
+    mrl_print(self, cmd + i);
+    cmd[j] = ch;
+    if (MRL_SHADOW_ON(self)) memcpy(sh + i, cmd + i, j - i);
+    self->tpos = i = j;
+  }
+
+  if (self->slen > n)
+  { // erase old tail
+    mrl_terminal_cursor(self, n);
+#ifndef MRL_PRINT_ESC_OFF
+    mrl_print(self, "\033[K");
+#else
+    mrl_terminal_spaces(self, self->slen - n);
+#endif // MRL_PRINT_ESC_OFF
+  }
+  self->slen = n;
+
+  mrl_terminal_cursor(self, self->cursor);
+}
+#endif // MRL_USE_SHADOW
+//-----------------------------------------------------------------------------
+#ifndef MRL_ECHO_OFF
+// terminal cursor is at the end of command line (fast path may be used)
+INLINE bool mrl_terminal_at_end(const mrl_t *self)
+{
+  return self->cursor == self->cmdlen && self->tpos == self->cmdlen
+#ifdef MRL_USE_SHADOW
+         && self->slen == self->cmdlen
+#endif // MRL_USE_SHADOW
+         && !self->defer;
+}
+//-----------------------------------------------------------------------------
+// show command line changed from 'from' position and set cursor
+// (len - length of command line on terminal before change)
+static void mrl_update(mrl_t *self, int from, int len)
+{
+  if (self->defer)
+  { // bulk input: remember changed region only
+    if (self->dirty < 0)
+    {
+      self->dirty     = from;
+      self->dirty_len = len;
+    }
+    else if (self->dirty > from)
+      self->dirty = from;
+    return;
+  }
+
+#ifdef MRL_USE_SHADOW
+  mrl_render(self);
+#else
+  mrl_terminal_cursor(self, from);
+  mrl_terminal_print(self, self->cmdline + from);
+#ifdef MRL_PRINT_ESC_OFF
+  if (len > self->cmdlen) // erase tail of old command line
+    mrl_terminal_spaces(self, len - self->cmdlen);
 #endif // MRL_PRINT_ESC_OFF
+  mrl_terminal_cursor(self, self->cursor);
+#endif // MRL_USE_SHADOW
+}
+//-----------------------------------------------------------------------------
+// show all deferred changes of command line (end of bulk input)
+static void mrl_commit(mrl_t *self)
+{
+  self->defer = false;
+  if (self->dirty >= 0)
+  {
+    mrl_update(self, self->dirty < self->cmdlen ? self->dirty : self->cmdlen,
+               self->dirty_len);
+    self->dirty = -1;
+  }
+  else
+    mrl_terminal_cursor(self, self->cursor);
+}
+#endif // !MRL_ECHO_OFF
+//-----------------------------------------------------------------------------
+// show cursor position
+INLINE void mrl_update_cursor(mrl_t *self)
+{
+#ifndef MRL_ECHO_OFF
+  if (self->defer) return; // bulk input: set cursor by mrl_commit()
+#endif // !MRL_ECHO_OFF
+  mrl_terminal_cursor(self, self->cursor);
 }
 //-----------------------------------------------------------------------------
 // cursor LEFT or Ctrl+B pressed
@@ -285,13 +1415,13 @@ static void mrl_cursor_back(mrl_t *self)
 #ifndef MRL_ECHO_OFF
   if (self->cursor > 0)
   {
-    mrl_terminal_cursor_back(self);
     self->cursor--;
+    mrl_update_cursor(self);
   }
 #else
   if (self->cursor > 0)
     self->cursor--;
-  mrl_terminal_cursor(self, self->cursor);
+  mrl_update_cursor(self);
 #endif // MRL_ECHO_OFF
 }
 //-----------------------------------------------------------------------------
@@ -301,47 +1431,85 @@ static void mrl_cursor_forward(mrl_t *self)
 #ifndef MRL_ECHO_OFF
   if (self->cursor < self->cmdlen)
   {
-    mrl_terminal_cursor_forward(self);
     self->cursor++;
+    mrl_update_cursor(self);
   }
 #else
   if (self->cursor < self->cmdlen)
     self->cursor++;
 
-  mrl_terminal_cursor(self, self->cursor);
+  mrl_update_cursor(self);
 #endif // MRL_ECHO_OFF
 }
 //-----------------------------------------------------------------------------
+#ifdef MRL_USE_ESC_SEQ
+// Ctrl+LEFT or Alt+B pressed (move cursor to begin of word)
+static void mrl_cursor_word_back(mrl_t *self)
+{
+  while (self->cursor > 0 && self->cmdline[self->cursor - 1] == ' ')
+    self->cursor--;
+  while (self->cursor > 0 && self->cmdline[self->cursor - 1] != ' ')
+    self->cursor--;
+  mrl_update_cursor(self);
+}
+//-----------------------------------------------------------------------------
+// Ctrl+RIGHT or Alt+F pressed (move cursor to end of word)
+static void mrl_cursor_word_forward(mrl_t *self)
+{
+  while (self->cursor < self->cmdlen && self->cmdline[self->cursor] == ' ')
+    self->cursor++;
+  while (self->cursor < self->cmdlen && self->cmdline[self->cursor] != ' ')
+    self->cursor++;
+  mrl_update_cursor(self);
+}
+#endif // MRL_USE_ESC_SEQ
+//-----------------------------------------------------------------------------
 // HOME or Ctrl+A pressed
 INLINE void mrl_cursor_home(mrl_t *self)
 {
-  mrl_terminal_cursor(self, self->cursor = 0);
+  self->cursor = 0;
+  mrl_update_cursor(self);
 }
 //-----------------------------------------------------------------------------
 // END or Ctrl+E pressed
 INLINE void mrl_cursor_end(mrl_t *self)
 {
-  mrl_terminal_cursor(self, self->cursor = self->cmdlen);
+  self->cursor = self->cmdlen;
+  mrl_update_cursor(self);
 }
 //-----------------------------------------------------------------------------
 // BACKSPACE or Ctrl+H pressed
 INLINE void mrl_backspace(mrl_t *self)
 {
-  if (self->cursor > 0)
-  {
 #ifndef MRL_ECHO_OFF
-    mrl_terminal_cursor_back(self);
+  if (self->cursor > 0 && mrl_terminal_at_end(self))
+  { // fast path: delete last char
+    self->cmdline[--self->cmdlen] = '\0';
+    self->cursor = self->tpos = self->cmdlen;
+#ifdef MRL_USE_SHADOW
+    self->slen = self->cmdlen;
+#endif // MRL_USE_SHADOW
+    mrl_print(self, "\b \b");
+    return;
+  }
 #endif // !MRL_ECHO_OFF
+
+  if (self->cursor > 0)
+  {
     memmove(self->cmdline + self->cursor - 1,
             self->cmdline + self->cursor,
             self->cmdlen  - self->cursor + 1);
     self->cursor--;
     self->cmdlen--;
+#ifndef MRL_ECHO_OFF
+    mrl_update(self, self->cursor, self->cmdlen + 1);
+#else
     mrl_terminal_print(self, self->cmdline + self->cursor);
 #ifdef MRL_PRINT_ESC_OFF
-    self->print(" ");
+    mrl_terminal_spaces(self, 1);
 #endif // MRL_PRINT_ESC_OFF
     mrl_terminal_cursor(self, self->cursor);
+#endif // MRL_ECHO_OFF
   }
 #ifdef MRL_ECHO_OFF
   else
@@ -349,7 +1517,7 @@ INLINE void mrl_backspace(mrl_t *self)
     mrl_terminal_cursor_forward(self);
     mrl_terminal_print(self, self->cmdline + self->cursor);
 #ifdef MRL_PRINT_ESC_OFF
-    self->print(" ");
+    mrl_terminal_spaces(self, 1);
 #endif // MRL_PRINT_ESC_OFF
     mrl_terminal_cursor(self, self->cursor);
   }
@@ -365,35 +1533,64 @@ INLINE void mrl_delete(mrl_t *self)
             self->cmdline + self->cursor + 1,
             self->cmdlen  - self->cursor + 1);
     self->cmdlen--;
+#ifndef MRL_ECHO_OFF
+    mrl_update(self, self->cursor, self->cmdlen + 1);
+#else
     mrl_terminal_print(self, self->cmdline + self->cursor);
 #ifdef MRL_PRINT_ESC_OFF
-    self->print(" ");
+    mrl_terminal_spaces(self, 1);
 #endif // MRL_PRINT_ESC_OFF
     mrl_terminal_cursor(self, self->cursor);
+#endif // MRL_ECHO_OFF
   }
 }
 //-----------------------------------------------------------------------------
 // Alt+BACKSPACE or Ctrl+U presed
 static void mrl_del_before_cursor(mrl_t *self)
 {
-#ifdef MRL_PRINT_ESC_OFF
-  int i = self->cursor;
-#endif // MRL_PRINT_ESC_OFF
+#if !defined(MRL_ECHO_OFF) || defined(MRL_PRINT_ESC_OFF)
+  int len = self->cmdlen;
+#endif // !MRL_ECHO_OFF || MRL_PRINT_ESC_OFF
   memmove(self->cmdline,
           self->cmdline + self->cursor,
           self->cmdlen - self->cursor + 1);
   self->cmdlen -= self->cursor;
   self->cursor = 0;
+#ifndef MRL_ECHO_OFF
+  mrl_update(self, 0, len);
+#else
   mrl_terminal_cursor(self, 0);
   mrl_terminal_print(self, self->cmdline);
 #ifdef MRL_PRINT_ESC_OFF
-  while (i > 0)
-  {
-    self->print(" ");
-    i--;
-  }
+  mrl_terminal_spaces(self, len - self->cmdlen);
 #endif // MRL_PRINT_ESC_OFF
   mrl_terminal_cursor(self, self->cursor = 0);
+#endif // MRL_ECHO_OFF
+}
+//-----------------------------------------------------------------------------
+// Ctrl+K pressed
+static void mrl_del_after_cursor(mrl_t *self)
+{
+#ifndef MRL_ECHO_OFF
+  int len = self->cmdlen;
+  self->cmdlen = self->cursor;
+  self->cmdline[self->cmdlen] = '\0';
+  mrl_update(self, self->cursor, len);
+#else
+  mrl_print(self, "\n");
+#ifndef MRL_PRINT_ESC_OFF
+  mrl_print(self, "\033[K");
+  self->cmdlen = self->cursor;
+  self->cmdline[self->cmdlen] = '\0';
+#else
+  mrl_terminal_newline(self);
+  mrl_terminal_prompt(self);
+  self->cmdlen = self->cursor;
+  self->cmdline[self->cmdlen] = '\0';
+  mrl_terminal_print(self, self->cmdline);
+  mrl_terminal_cursor(self, self->cursor);
+#endif // MRL_PRINT_ESC_OFF
+#endif // MRL_ECHO_OFF
 }
 //-----------------------------------------------------------------------------
 #ifdef MRL_USE_HISTORY
@@ -401,77 +1598,318 @@ static void mrl_del_before_cursor(mrl_t *self)
 static void mrl_hist(mrl_t *self, int dir)
 {
   int len;
+#ifdef MRL_USE_HIST_PREFIX
+  if (self->hist.cur < 0)
+    self->hist.prefix = self->cursor; // enter to history search mode
+#endif // MRL_USE_HIST_PREFIX
   len = mrl_hist_search(&self->hist, dir, self->cmdline);
   if (len >= 0)
   {
-#ifdef MRL_PRINT_ESC_OFF
+#ifndef MRL_ECHO_OFF
     int i = self->cmdlen;
     self->cursor = self->cmdlen = len;
-    mrl_terminal_cursor(self, 0);
-    while (i > 0)
-    {
-      self->print(" ");
-      i--;
-    }
+    mrl_update(self, 0, i);
 #else
-    self->cursor = self->cmdlen = len;
+#ifdef MRL_PRINT_ESC_OFF
+    mrl_terminal_cursor(self, 0);
+    mrl_terminal_spaces(self, self->cmdlen);
 #endif // MRL_PRINT_ESC_OFF
+    self->cursor = self->cmdlen = len;
     mrl_terminal_cursor(self, 0);
     mrl_terminal_print(self, self->cmdline);
+#endif // MRL_ECHO_OFF
   }
 }
 #endif // MRL_USE_HISTORY
 //-----------------------------------------------------------------------------
-// split cmdline to tkn array and return nmb of token
-// replace all whitespaces to '\0'
-static int mrl_split(char *str, int len, char **argv)
+#ifdef MRL_USE_HIST_SEARCH
+// show search string and found line (cursor at the end)
+static void mrl_search_show(mrl_t *self)
 {
-  int argc = 0, i = 0;
-  while (1)
-  {
-    // skip whitespaces and replace them to '\0'
-    while ((str[i] == ' ') && (i < len))
-      str[i++] = '\0';
+  const mrl_hist_t *hist = &self->hist;
+  char str[2] = { '\0', '\0' };
 
-    if (i >= len) break;
-
-    argv[argc++] = str + i;
+  mrl_terminal_clear(self);
+  mrl_print(self, self->search_fail ? "(failed reverse-i-search)`" :
+                                      "(reverse-i-search)`");
+  mrl_print(self, self->search_str);
+  mrl_print(self, "': ");
 
-    if (argc >= MRL_COMMAND_TOKEN_NUM) break;
+  if (self->search_pos >= 0)
+  {
+    int i = mrl_hist_at(hist, mrl_hist_line_begin(hist, self->search_pos));
+    int j = i;
 
-    // skip NOT whitespaces
-    while ((str[i] != ' ') && (i < len))
-      i++;
-    
-    if (i >= len) break;
+    while (j < MRL_HIST_LEN(hist) && hist->buf[j] != '\0') j++;
+    if (j == MRL_HIST_LEN(hist))
+    { // line wrap around end of ring buffer
+      for (; i < MRL_HIST_LEN(hist); i++)
+      {
+        str[0] = hist->buf[i];
+        mrl_print(self, str);
+      }
+      i = 0;
+    }
+    mrl_print(self, hist->buf + i);
   }
-  argv[argc] = (char*) NULL;
-  return argc;
 }
 //-----------------------------------------------------------------------------
-#ifdef MRL_USE_COMPLETE
-// insert len char of text at cursor position
-static void mrl_insert_text(mrl_t *self, const char *text, int len)
+// find search string in history before position 'to'
+static void mrl_search_find(mrl_t *self, int to)
 {
-  if (len > MRL_COMMAND_LINE_LEN - 1 - self->cmdlen) 
-    len = MRL_COMMAND_LINE_LEN - 1 - self->cmdlen;
-  
-  if (len > 0)
-  {
-    char *p1 = self->cmdline + self->cursor;
-    char *p2 = p1 + len;
-    memmove(p2, p1, self->cmdlen - self->cursor + 1);
-
-    memcpy(p1, text, len);
+  int pos = mrl_hist_find(&self->hist, self->search_str, self->search_len, to);
+  self->search_fail = pos < 0;
+  if (pos >= 0) self->search_pos = pos;
+}
+//-----------------------------------------------------------------------------
+// enter to reverse history search mode
+static void mrl_search_start(mrl_t *self)
+{
+  self->search      = true;
+  self->search_fail = false;
+  self->search_len  = 0;
+  self->search_pos  = -1;
+  self->search_str[0] = '\0';
+  mrl_search_show(self);
+}
+//-----------------------------------------------------------------------------
+// go out from search mode (accept found line or keep edited line)
+static void mrl_search_stop(mrl_t *self, bool accept)
+{
+  self->search = false;
+
+  if (accept && self->search_pos >= 0)
+  {
+    const mrl_hist_t *hist = &self->hist;
+    int begin = mrl_hist_line_begin(hist, self->search_pos);
+    int i = mrl_hist_at(hist, begin), len = 0;
+
+    while ((self->cmdline[len] = hist->buf[i]) != '\0')
+    {
+      if (++i == MRL_HIST_LEN(hist)) i = 0;
+      len++;
+    }
+    self->cmdlen = len;
+    self->cursor = self->search_pos - begin; // at found string
+    self->hist.cur = -1; // go out from history search mode
+  }
+
+  mrl_terminal_clear(self);
+  mrl_terminal_prompt(self);
+  mrl_terminal_print(self, self->cmdline);
+  mrl_terminal_cursor(self, self->cursor);
+#ifdef MRL_USE_SHADOW
+  mrl_shadow_sync(self);
+#endif // MRL_USE_SHADOW
+}
+//-----------------------------------------------------------------------------
+// handle key in search mode (return false if key must be handled as usual)
+static bool mrl_search_key(mrl_t *self, int ch)
+{
+  mrl_hist_t *hist = &self->hist;
+
+  switch (ch)
+  {
+    case MRL_KEY_DC2: // Ctrl+R - find older line
+      if (self->search_pos >= 0 && !self->search_fail)
+        mrl_search_find(self,
+                        mrl_hist_line_begin(hist, self->search_pos) - 1);
+      break;
+
+    case MRL_KEY_DEL: // BACKSPACE
+    case MRL_KEY_BS:  // CTLR+H
+      if (self->search_len == 0) break;
+      self->search_str[--self->search_len] = '\0';
+      self->search_fail = false;
+      self->search_pos  = -1;
+      if (self->search_len)
+        mrl_search_find(self, mrl_hist_used(hist)); // from newest line
+      break;
+
+    case MRL_KEY_BEL: // Ctrl+G - cancel search
+      mrl_search_stop(self, false);
+      return true;
+
+    default:
+      if (MRL_IS_CONTROL_CHAR(ch))
+      { // accept found line and handle key
+        mrl_search_stop(self, true);
+        return false;
+      }
+
+      if (self->search_len == MRL_HIST_SEARCH_LEN) break;
+      self->search_str[self->search_len++] = ch;
+      self->search_str[self->search_len]   = '\0';
+      if (!self->search_fail) // longer string is not found too
+        mrl_search_find(self, self->search_pos >= 0 ?
+                              mrl_hist_line_end(hist, self->search_pos) :
+                              mrl_hist_used(hist)); // current or older line
+      break;
+  }
+
+  mrl_search_show(self);
+  return true;
+}
+#endif // MRL_USE_HIST_SEARCH
+//-----------------------------------------------------------------------------
+// split cmdline to tkn array and return nmb of token
+// replace all whitespaces to '\0' (num - max number of tokens)
+static int mrl_split(char *str, int len, char **argv, int num)
+{
+  int argc = 0, i = 0;
+  while (1)
+  {
+    // skip whitespaces and replace them to '\0'
+    while ((str[i] == ' ') && (i < len))
+      str[i++] = '\0';
+
+    if (i >= len) break;
+
+    argv[argc++] = str + i;
+
+    if (argc >= num) break;
+
+    // skip NOT whitespaces
+    while ((str[i] != ' ') && (i < len))
+      i++;
     
+    if (i >= len) break;
+  }
+  argv[argc] = (char*) NULL;
+  return argc;
+}
+//-----------------------------------------------------------------------------
+// copy tokens to caller buffer (for use after 'execute' callback return)
+int mrl_argv_copy(char *buf, int size, char **dst,
+                  int argc, char * const argv[])
+{
+  int i, len, used = 0;
+
+  for (i = 0; i < argc; i++)
+  {
+    len = strlen(argv[i]) + 1;
+    if (used + len > size) return -1; // buffer too small
+
+    memcpy(buf + used, argv[i], len);
+    dst[i] = buf + used;
+    used += len;
+  }
+  dst[argc] = (char*) NULL;
+
+  return used;
+}
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_CMD
+// compare record of command tree with key (parent ID, name)
+INLINE int mrl_cmd_cmp(const mrl_cmd_t *cmd, int parent, const char *name)
+{
+  if (cmd->parent != parent)
+    return cmd->parent < parent ? -1 : 1;
+  return strcmp(cmd->name, name);
+}
+//-----------------------------------------------------------------------------
+// index of first record not less than key (parent ID, name), binary search
+static int mrl_cmd_lower(const mrl_t *self, int parent, const char *name)
+{
+  int lo = 0, hi = self->cmd_num;
+
+  while (lo < hi)
+  {
+    int mid = (lo + hi) >> 1;
+    if (mrl_cmd_cmp(self->cmd + mid, parent, name) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+//-----------------------------------------------------------------------------
+// set command tree (return false if records are not sorted)
+bool mrl_set_cmd(mrl_t *self, const mrl_cmd_t *cmd)
+{
+  int i;
+
+  self->cmd     = NULL;
+  self->cmd_num = 0;
+#ifdef MRL_USE_COMPL_CACHE
+  self->cache_len = 0;
+#endif // MRL_USE_COMPL_CACHE
+  if (cmd == NULL) return true;
+
+  for (i = 0; cmd[i].name != NULL; i++)
+    if (i > 0 && mrl_cmd_cmp(cmd + i - 1, cmd[i].parent, cmd[i].name) >= 0)
+      return false; // not sorted or duplicated name
+
+  self->cmd     = cmd;
+  self->cmd_num = i;
+  return true;
+}
+//-----------------------------------------------------------------------------
+// find command/option by tokens
+const mrl_cmd_t *mrl_cmd_find(const mrl_t *self, int argc,
+                              char * const argv[], int *used)
+{
+  const mrl_cmd_t *found = NULL;
+  int i, parent = -1;
+
+  for (i = 0; i < argc; i++)
+  {
+    int j = mrl_cmd_lower(self, parent, argv[i]);
+    if (j >= self->cmd_num || mrl_cmd_cmp(self->cmd + j, parent, argv[i]) != 0)
+      break; // not command/option (argument)
+
+    found  = self->cmd + j;
+    parent = found->id;
+  }
+
+  *used = i;
+  return found;
+}
+//-----------------------------------------------------------------------------
+// get options of command
+const mrl_cmd_t *mrl_cmd_children(const mrl_t *self, int parent, int *num)
+{
+  int first = mrl_cmd_lower(self, parent, "");
+  int last  = mrl_cmd_lower(self, parent + 1, "");
+
+  *num = last - first;
+  return self->cmd + first;
+}
+//-----------------------------------------------------------------------------
+// find record by ID
+const mrl_cmd_t *mrl_cmd_by_id(const mrl_t *self, int id)
+{
+  int i;
+  for (i = 0; i < self->cmd_num; i++)
+    if (self->cmd[i].id == id)
+      return self->cmd + i;
+  return NULL;
+}
+#endif // MRL_USE_CMD
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_COMPLETE
+// show len chars inserted at cursor position (cursor is moved after them)
+static void mrl_show_inserted(mrl_t *self, int len)
+{
+  if (len > 0)
+  {
+#ifdef MRL_ECHO_OFF
+    char *p1 = self->cmdline + self->cursor;
+#endif
     self->cmdlen += len;
 
+#ifndef MRL_ECHO_OFF
+    self->cursor += len;
+    mrl_update(self, self->cursor - len, self->cmdlen - len);
+#else
     mrl_terminal_cursor(self, self->cursor);
     mrl_terminal_print(self, p1);
-    
+
     self->cursor += len;
-    
+
     mrl_terminal_cursor(self, self->cursor);
+#endif // MRL_ECHO_OFF
   }
 #ifdef MRL_ECHO_OFF
   else
@@ -481,14 +1919,74 @@ static void mrl_insert_text(mrl_t *self, const char *text, int len)
   }
 #endif // MRL_ECHO_OFF
 }
+//-----------------------------------------------------------------------------
+// insert len char of text at cursor position
+static void mrl_insert_text(mrl_t *self, const char *text, int len)
+{
+  if (len > MRL_LINE_LEN(self) - 1 - self->cmdlen)
+    len = MRL_LINE_LEN(self) - 1 - self->cmdlen;
+
+  if (len > 0)
+  {
+    char *p1 = self->cmdline + self->cursor;
+    char *p2 = p1 + len;
+    memmove(p2, p1, self->cmdlen - self->cursor + 1);
+
+    memcpy(p1, text, len);
+  }
+
+  mrl_show_inserted(self, len);
+}
+//-----------------------------------------------------------------------------
+// reverse order of len chars
+static void mrl_reverse(char *p, int len)
+{
+  char *q = p + len - 1;
+  while (p < q)
+  {
+    char c = *p;
+    *p++ = *q;
+    *q-- = c;
+  }
+}
+//-----------------------------------------------------------------------------
+// insert len chars kept in free tail of cmdline (after '\0') at cursor
+// position (chars after cursor and tail are rotated in place)
+static void mrl_insert_tail(mrl_t *self, int len)
+{
+  char *p = self->cmdline + self->cursor;
+  int rest = self->cmdlen - self->cursor + 1; // chars after cursor and '\0'
+
+  mrl_reverse(p, rest);
+  mrl_reverse(p + rest, len);
+  mrl_reverse(p, rest + len);
+
+  mrl_show_inserted(self, len);
+}
 #endif // MRL_USE_COMPLETE
 //-----------------------------------------------------------------------------
 // insert one char to cursor position
 static void mrl_insert_chr(mrl_t *self, char chr)
 {
-  if (self->cmdlen < MRL_COMMAND_LINE_LEN - 1) 
+  if (self->cmdlen < MRL_LINE_LEN(self) - 1) 
   {
     char *ptr = self->cmdline + self->cursor;
+#ifndef MRL_ECHO_OFF
+    if (mrl_terminal_at_end(self))
+    { // fast path: append char to end of line (only echo it)
+      char str[2];
+      str[0] = ptr[0] = chr;
+      str[1] = ptr[1] = '\0';
+#ifdef MRL_USE_SHADOW
+      if (MRL_SHADOW_ON(self))
+        self->shadow[self->cmdlen] = chr;
+      self->slen++;
+#endif // MRL_USE_SHADOW
+      self->cursor = self->tpos = ++self->cmdlen;
+      mrl_print(self, str);
+      return;
+    }
+#endif // !MRL_ECHO_OFF
     memmove(ptr + 1, ptr, self->cmdlen - self->cursor + 1);
     *ptr = chr;
 
@@ -501,10 +1999,8 @@ static void mrl_insert_chr(mrl_t *self, char chr)
     }
 #else
     self->cmdlen++;
-    mrl_terminal_cursor(self, self->cursor);
-    mrl_terminal_print(self, ptr);
     self->cursor++;
-    mrl_terminal_cursor(self, self->cursor);
+    mrl_update(self, self->cursor - 1, self->cmdlen - 1);
 #endif // MRL_ECHO_OFF
   }
 #ifdef MRL_ECHO_OFF
@@ -528,98 +2024,436 @@ INLINE void mrl_back_replace_spaces(char *str, int len)
       str[i] = ' ';
 }
 //-----------------------------------------------------------------------------
-static int mrl_common_len(const char * const argv[])
+// completion state (variants are given one by one: first pass counts
+// variants and finds common part, second pass prints variants)
+struct mrl_compl_ {
+  mrl_t *self;
+  const char **variants; // array from 'completion' callback (or NULL)
+  int tlen;  // length of completed (last) token
+  int num;   // number of variants (first pass) or variants in line (second)
+  int len;   // length of common part of variants after token
+  bool list; // second pass (print variants)
+#ifdef MRL_USE_COMPL_CACHE
+  bool cached; // variants are given from cache
+  bool fill;   // variants are saved to cache
+#endif // MRL_USE_COMPL_CACHE
+#ifdef MRL_COMPLETE_WIDTH
+  int maxlen; // max length of variant
+  int colw;   // column width (max length + 2 spaces)
+  int cols;   // number of columns
+  int rowlen; // number of chars in row buffer
+  char row[MRL_COMPLETE_WIDTH + sizeof(MRL_ENDL)]; // row of variants + ENDL
+#endif // MRL_COMPLETE_WIDTH
+};
+//-----------------------------------------------------------------------------
+#ifdef MRL_COMPLETE_WIDTH
+// print row of completion variants by one call (with new line)
+static void mrl_compl_row(mrl_compl_t *compl)
 {
-  int i, j;
-  const char *shortest = argv[0];
-  int shortlen = strlen(shortest);
+  if (compl->rowlen > 0)
+  {
+    strcpy(compl->row + compl->rowlen, MRL_ENDL);
+    mrl_print(compl->self, compl->row);
+    compl->self->tpos = MRL_TPOS_UNKNOWN;
+    compl->rowlen = 0;
+  }
+}
+//-----------------------------------------------------------------------------
+// put variant to row in aligned column
+static void mrl_compl_cell(mrl_compl_t *compl, const char *str, int len)
+{
+  if (compl->num == compl->cols)
+  { // row is full
+    mrl_compl_row(compl);
+    compl->num = 0;
+  }
+
+  if (len > MRL_COMPLETE_WIDTH)
+  { // too long variant (one column, row is empty)
+    mrl_print(compl->self, str);
+    mrl_terminal_newline(compl->self);
+    return;
+  }
+
+  while (compl->rowlen < compl->num * compl->colw)
+    compl->row[compl->rowlen++] = ' '; // align column
+
+  memcpy(compl->row + compl->rowlen, str, len);
+  compl->rowlen += len;
+  compl->num++;
+}
+#endif // MRL_COMPLETE_WIDTH
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_COMPL_CACHE
+// check that cached variants may be used for token at cursor: line before
+// token is not changed and token is started with cached token
+static bool mrl_cache_hit(mrl_t *self, int *tlen)
+{
+  int start = self->cursor;
+
+  if (self->cache_len == 0 || self->cursor != self->cmdlen)
+    return false;
+
+  while (start > 0 && self->cmdline[start - 1] != ' ')
+    start--;
+
+  if (start != self->cache_key || self->cursor - start < self->cache_tok ||
+      memcmp(self->cmdline, self->cache, start + self->cache_tok) != 0)
+    return false;
+
+  *tlen = self->cursor - start;
+  return true;
+}
+//-----------------------------------------------------------------------------
+// save line before token and token to cache (command line is split)
+static bool mrl_cache_start(mrl_t *self, int tlen)
+{
+  int i, start = self->cursor - tlen;
+
+  self->cache_len = 0;
+  if (self->cursor != self->cmdlen || self->cursor >= MRL_COMPL_CACHE_LEN ||
+      (start > 0 && self->cmdline[start - 1] != '\0'))
+    return false; // token is not at end of line
+
+  for (i = 0; i < self->cursor; i++)
+    self->cache[i] = self->cmdline[i] == '\0' ? ' ' : self->cmdline[i];
+
+  self->cache_key = start;
+  self->cache_tok = tlen;
+  self->cache_len = self->cursor;
+  return true;
+}
+//-----------------------------------------------------------------------------
+// save variant to cache (cache is dropped if it is full or variant is not
+// started with token)
+static void mrl_cache_add(mrl_compl_t *compl, const char *str)
+{
+  mrl_t *self = compl->self;
+  int len = strlen(str) + 1;
 
-  for (i = 1; argv[i] != NULL; i++)
+  if (self->cache_len + len > MRL_COMPL_CACHE_LEN ||
+      strncmp(str, self->cmdline + self->cache_key, compl->tlen) != 0)
   {
-    int len = strlen(argv[i]);
-    if (shortlen > len)
+    self->cache_len = 0;
+    compl->fill = false;
+    return;
+  }
+
+  memcpy(self->cache + self->cache_len, str, len);
+  self->cache_len += len;
+}
+//-----------------------------------------------------------------------------
+// give cached variants started with token
+static void mrl_cache_give(mrl_compl_t *compl)
+{
+  mrl_t *self = compl->self;
+  const char *tok = self->cmdline + self->cursor - compl->tlen;
+  int i = self->cache_key + self->cache_tok;
+
+  while (i < self->cache_len)
+  {
+    const char *str = self->cache + i;
+    if (strncmp(str, tok, compl->tlen) == 0)
+      mrl_compl_add(compl, str);
+    i += strlen(str) + 1;
+  }
+}
+#endif // MRL_USE_COMPL_CACHE
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_COMPL_MENU
+// replace token by next (dir = 1) or previous (dir = -1) cached variant
+// started with typed token (only changed part of token is redrawn)
+static void mrl_menu_step(mrl_t *self, int dir)
+{
+  char *tok = self->cmdline + self->cache_key;
+  const char *str = self->cache;
+  int i, n, len, from, num = 0, old = self->cmdlen;
+  int first = self->cache_key + self->cache_tok;
+
+  for (i = first; i < self->cache_len; i += strlen(self->cache + i) + 1)
+    if (strncmp(self->cache + i, tok, self->menu_tok) == 0)
+      num++;
+
+  if (num == 0)
+  {
+    self->menu = -1;
+    return;
+  }
+
+  n = self->menu = (self->menu + dir + num) % num;
+  for (i = first; i < self->cache_len; i += strlen(str) + 1)
+  {
+    str = self->cache + i;
+    if (strncmp(str, tok, self->menu_tok) == 0 && n-- == 0)
+      break;
+  }
+
+  len = strlen(str);
+  if (len > MRL_LINE_LEN(self) - 1 - self->cache_key)
+    len = MRL_LINE_LEN(self) - 1 - self->cache_key;
+
+  // skip the same chars of old and new variants
+  for (from = self->menu_tok; from < len && self->cache_key + from < old &&
+                              tok[from] == str[from]; from++);
+
+  memcpy(tok + from, str + from, len - from);
+  self->cmdlen = self->cursor = self->cache_key + len;
+  self->cmdline[self->cmdlen] = '\0';
+
+  mrl_update(self, self->cache_key + from, old);
+}
+#endif // MRL_USE_COMPL_MENU
+//-----------------------------------------------------------------------------
+// give one completion variant to library
+void mrl_compl_add(mrl_compl_t *compl, const char *str)
+{
+  mrl_t *self = compl->self;
+  char *tail;
+  int i;
+#ifdef MRL_COMPLETE_WIDTH
+  int len = strlen(str);
+
+  if (compl->list)
+  { // print variant
+    mrl_compl_cell(compl, str, len);
+    return;
+  }
+
+  if (compl->maxlen < len)
+    compl->maxlen = len;
+#else
+  if (compl->list)
+  { // print variant
+#ifdef MRL_COMPLETE_COLS
+    if (++compl->num > MRL_COMPLETE_COLS)
     {
-      shortest = argv[i];
-      shortlen = len;
+      compl->num = 1;
+      mrl_terminal_newline(self);
     }
+#endif
+    mrl_print(self, str);
+    mrl_print(self, " ");
+    return;
+  }
+#endif // MRL_COMPLETE_WIDTH
+
+#ifdef MRL_USE_COMPL_CACHE
+  if (compl->fill)
+    mrl_cache_add(compl, str);
+#endif // MRL_USE_COMPL_CACHE
+
+  // skip completed token
+  for (i = 0; i < compl->tlen && str[i] != '\0'; i++);
+  str += i;
+
+  // common part of variants is kept in free tail of cmdline
+  tail = self->cmdline + self->cmdlen + 1;
+  i = 0;
+  if (compl->num++ == 0)
+  { // first variant
+    int size = MRL_LINE_LEN(self) - 1 - self->cmdlen;
+    for (; i < size && str[i] != '\0'; i++)
+      tail[i] = str[i];
+  }
+  else
+  {
+    while (i < compl->len && tail[i] == str[i])
+      i++;
   }
+  compl->len = i;
+}
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_CMD
+// give names of commands/options started with last token
+static void mrl_cmd_complete(mrl_t *self, int argc, char * const argv[],
+                             mrl_compl_t *compl)
+{
+  int i, used, len, parent = -1;
+  const mrl_cmd_t *cmd = mrl_cmd_find(self, argc - 1, argv, &used);
+
+  if (argc < 1 || used != argc - 1)
+    return; // some token before last is argument
 
-  for (i = 0; i < shortlen; i++)
-    for (j = 0; argv[j] != NULL; j++)
-      if (shortest[i] != argv[j][i])
-        return i;
+  if (cmd != NULL) parent = cmd->id;
+  len = strlen(argv[argc - 1]);
 
-  return shortlen;
+  for (i = mrl_cmd_lower(self, parent, argv[argc - 1]);
+       i < self->cmd_num; i++)
+  {
+    cmd = self->cmd + i;
+    if (cmd->parent != parent || strncmp(cmd->name, argv[argc - 1], len) != 0)
+      break;
+    mrl_compl_add(compl, cmd->name);
+  }
+}
+#endif // MRL_USE_CMD
+//-----------------------------------------------------------------------------
+// give all completion variants (by callback or from command tree)
+static void mrl_compl_run(mrl_t *self, mrl_compl_t *compl,
+                          int argc, char * const argv[])
+{
+  const char **variants = compl->variants;
+
+#ifdef MRL_USE_COMPL_CACHE
+  if (compl->cached)
+  { // callback is not called
+    mrl_cache_give(compl);
+    return;
+  }
+#endif // MRL_USE_COMPL_CACHE
+
+  if (self->complete != NULL)
+  { // streaming callback is called on each pass
+    mrl_flush(self);
+    self->complete(self->ctx, argc, argv, compl);
+    self->tpos = MRL_TPOS_UNKNOWN; // callback may print something
+    return;
+  }
+
+  if (self->get_completion != NULL)
+  {
+    if (variants == NULL)
+    { // array callback is called once
+      mrl_flush(self);
+      variants = compl->variants = self->get_completion(self->ctx, argc, argv);
+      self->tpos = MRL_TPOS_UNKNOWN; // callback may print something
+    }
+    while (*variants != NULL)
+      mrl_compl_add(compl, *variants++);
+    return;
+  }
+
+#ifdef MRL_USE_CMD
+  mrl_cmd_complete(self, argc, argv, compl);
+#endif // MRL_USE_CMD
 }
 //-----------------------------------------------------------------------------
 // TAB pressed
 INLINE void mrl_get_complite(mrl_t *self)
 {
-  int argc;
+  int argc, num;
+#ifdef MRL_USE_EXT_BUF
+  char **argv = self->argv;
+#else
   char *argv[MRL_COMMAND_TOKEN_NUM + 2];
-  const char **compl_argv;
-  
-  if (self->get_completion == NULL) return; // callback was not set
-  
-  argc = mrl_split(self->cmdline, self->cursor, argv);
+#endif
+  mrl_compl_t compl;
 
-  if (self->cmdline[self->cursor - 1] == '\0')
-  { // last char WAS whitespace
-    argv[argc++] = "";
-    argv[argc]   = NULL;
+#ifdef MRL_USE_CMD
+  if (self->complete == NULL && self->get_completion == NULL &&
+      self->cmd == NULL) return; // callbacks and command tree were not set
+#else
+  if (self->complete == NULL && self->get_completion == NULL)
+    return; // callbacks were not set
+#endif // MRL_USE_CMD
+
+#ifdef MRL_USE_COMPL_MENU
+  if (self->menu >= 0 && self->cache_len != 0)
+  { // next variant of menu completion
+    mrl_menu_step(self, 1);
+    return;
+  }
+  self->menu = -1;
+#endif // MRL_USE_COMPL_MENU
+
+  compl.self     = self;
+  compl.variants = NULL;
+  compl.num      = 0;
+  compl.len      = 0;
+  compl.list     = false;
+#ifdef MRL_COMPLETE_WIDTH
+  compl.maxlen   = 0;
+  compl.rowlen   = 0;
+#endif // MRL_COMPLETE_WIDTH
+
+#ifdef MRL_USE_COMPL_CACHE
+  compl.fill   = false;
+  compl.cached = mrl_cache_hit(self, &compl.tlen);
+  if (compl.cached)
+    argc = 0; // command line is not split
+  else
+#endif // MRL_USE_COMPL_CACHE
+  {
+    argc = mrl_split(self->cmdline, self->cursor, argv, MRL_TOKEN_NUM(self));
+
+    if (self->cursor == 0 || self->cmdline[self->cursor - 1] == '\0')
+    { // begin of line or last char WAS whitespace
+      argv[argc++] = "";
+      argv[argc]   = NULL;
+    }
+
+    compl.tlen = argc > 0 ? strlen(argv[argc - 1]) : 0;
+#ifdef MRL_USE_COMPL_CACHE
+    compl.fill = mrl_cache_start(self, compl.tlen);
+#endif // MRL_USE_COMPL_CACHE
   }
 
-  compl_argv = self->get_completion(argc, argv);
+  mrl_compl_run(self, &compl, argc, argv); // count variants, common part
+  num = compl.num;
+
+#ifdef MRL_USE_COMPL_CACHE
+  if (compl.fill)
+  { // all variants are in cache
+    compl.fill   = false;
+    compl.cached = true;
+  }
+#endif // MRL_USE_COMPL_CACHE
+
+#ifdef MRL_USE_COMPL_MENU
+  if (num > 1 && compl.cached)
+  { // start menu completion (list of variants is not printed)
+    mrl_back_replace_spaces(self->cmdline, self->cursor);
+    self->menu_tok = compl.tlen;
+    mrl_menu_step(self, 1);
+    return;
+  }
+#endif // MRL_USE_COMPL_MENU
+
+  if (num > 1)
+  { // some variants
+    mrl_terminal_newline(self);
+    compl.list = true;
+    compl.num  = 0;
+#ifdef MRL_COMPLETE_WIDTH
+    // columns are separated by 2 spaces (last column without spaces)
+    compl.colw = compl.maxlen + 2;
+    compl.cols = self->width < MRL_COMPLETE_WIDTH ?
+                 self->width : MRL_COMPLETE_WIDTH; // terminal width
+    compl.cols = (compl.cols + 2) / compl.colw;
+    if (compl.cols < 1) compl.cols = 1;
+    mrl_compl_run(self, &compl, argc, argv); // print variants
+    mrl_compl_row(&compl); // last row
+#else
+    mrl_compl_run(self, &compl, argc, argv); // print variants
+    mrl_terminal_newline(self);
+#endif // MRL_COMPLETE_WIDTH
+    mrl_terminal_prompt(self);
+#ifdef MRL_USE_SHADOW
+    mrl_shadow_reset(self);
+#endif // MRL_USE_SHADOW
+  }
 
   mrl_back_replace_spaces(self->cmdline, self->cursor);
 
-  if (compl_argv[0] != NULL)
+  if (num > 0)
   {
-    int len = 0;
-
-    if (compl_argv[1] == NULL)
-    { // only one variant
-      len = strlen(compl_argv[0]);
-    }
-    else
-    { // some variants
-      int i = 0;
-#ifdef MRL_COMPLETE_COLS
-      int num = 0;
-#endif
-      mrl_terminal_newline(self);
-      len = mrl_common_len(compl_argv);
-      while (compl_argv[i] != NULL)
-      {
-#ifdef MRL_COMPLETE_COLS
-        if (++num > MRL_COMPLETE_COLS)
-        {
-          num = 1;
-          mrl_terminal_newline(self);
-        }
-#endif
-        self->print(compl_argv[i]);
-        self->print(" ");
-        i++;
-      }
-      mrl_terminal_newline(self);
-      mrl_terminal_prompt(self);
-    }
-    
-    if (len)
+    if (compl.tlen + compl.len > 0)
     { // insert completion
-      mrl_insert_text(self, compl_argv[0] + strlen(argv[argc - 1]), 
-                      len - strlen(argv[argc - 1]));
+      mrl_insert_tail(self, compl.len);
 
-      if (compl_argv[1] == NULL &&            // only one variant and
+      if (num == 1 &&                         // only one variant and
           self->cmdline[self->cursor] != ' ') // no space at cursor
         mrl_insert_text(self, " ", 1);        // => append space
     }
 
+#ifndef MRL_ECHO_OFF
+    mrl_update(self, 0, self->cmdlen);
+#else
     mrl_terminal_cursor(self, 0);
     mrl_terminal_print(self, self->cmdline);
     mrl_terminal_cursor(self, self->cursor);
-  } 
+#endif // MRL_ECHO_OFF
+  }
 #ifdef MRL_ECHO_OFF
   else
   {
@@ -634,7 +2468,19 @@ INLINE void mrl_get_complite(mrl_t *self)
 static void mrl_new_line_handler(mrl_t *self)
 {
   int argc;
+#ifdef MRL_USE_EXT_BUF
+  char **argv = self->argv;
+#else
   char *argv[MRL_COMMAND_TOKEN_NUM + 1];
+#endif
+#ifdef MRL_USE_CMD
+  const mrl_cmd_t *cmd = NULL;
+  int used;
+#endif // MRL_USE_CMD
+
+#ifdef MRL_USE_COMPL_CACHE
+  self->cache_len = 0; // command may change completion variants
+#endif // MRL_USE_COMPL_CACHE
 
 #ifdef MRL_USE_HISTORY
   mrl_hist_save(&self->hist, self->cmdline);
@@ -647,198 +2493,721 @@ static void mrl_new_line_handler(mrl_t *self)
 
   mrl_terminal_newline(self);
   
-  argc = mrl_split(self->cmdline, self->cmdlen, argv);
+  argc = mrl_split(self->cmdline, self->cmdlen, argv, MRL_TOKEN_NUM(self));
+
+#ifdef MRL_USE_CMD
+  if (argc > 0 && self->cmd != NULL)
+    cmd = mrl_cmd_find(self, argc, argv, &used);
+
+  if (cmd != NULL && cmd->fn != NULL)
+  { // handler of command/option get rest of tokens
+    mrl_flush(self); // keep order of library and user output
+    cmd->fn(self->ctx, argc - used, argv + used, cmd);
+  }
+  else
+#endif // MRL_USE_CMD
+  if (argc > 0 && self->execute != NULL)
+  {
+    mrl_flush(self); // keep order of library and user output
+    self->execute(self->ctx, argc, argv);
+  }
+  
+  self->cmdline[0] = '\0';
+  self->cmdlen = 0;
+  self->cursor = 0;
+  mrl_terminal_prompt(self);
+#ifdef MRL_USE_SHADOW
+  mrl_shadow_reset(self);
+#endif // MRL_USE_SHADOW
+}
+//-----------------------------------------------------------------------------
+// init internal data (buffers are already set)
+static void mrl_init_data(mrl_t *self,
+                          void (*print)(void*, const char*), void *ctx)
+{
+#ifdef MRL_USE_HISTORY
+  mrl_hist_init(&self->hist);
+#ifdef MRL_USE_HIST_SHARED
+  self->hist.line_len = MRL_LINE_LEN(self);
+#endif // MRL_USE_HIST_SHARED
+#endif
+
+#ifdef MRL_USE_ESC_SEQ
+  self->escape_seq  = MRL_ESC_STOP;
+  self->escape_argn = 0;
+  self->escape_arg[0] = self->escape_arg[1] = 0;
+#endif
+
+#ifdef MRL_USE_PASTE
+  self->paste = 0;
+#endif
+
+#ifdef MRL_USE_HIST_SEARCH
+  self->search = false;
+#endif
+
+#ifdef MRL_USE_RXQ
+  self->rxq_head = self->rxq_tail = 0;
+  self->rxq_lost = self->rxq_max  = 0;
+#endif
+
+#if (defined(MRL_ENDL_CRLF) || defined(MRL_ENDL_LFCR))
+  self->tmpch = '\0';
+#endif
+  
+  self->prompt     = mrl_prompt_default;
+  self->prompt_len = MRL_PROMPT_DEFAULT_LEN;
+
+#ifdef MRL_DEBUG_HISTORY
+  memset(self->cmdline, '~', MRL_LINE_LEN(self));
+#endif
+
+  self->cmdline[0] = '\0';
+  self->cmdlen = 0;
+  self->cursor = 0;
+
+  self->ctx = ctx;
+  self->print = print;
+  self->execute = NULL;
+#ifdef MRL_USE_OUTBUF
+  self->outlen = 0;
+#endif
+  self->tpos = MRL_TPOS_UNKNOWN;
+#ifdef MRL_USE_SHADOW
+  self->slen = 0;
+#endif
+#ifndef MRL_ECHO_OFF
+  self->defer = false;
+  self->dirty = -1;
+#endif
+#ifdef MRL_USE_COMPLETE
+  self->get_completion = NULL;
+  self->complete = NULL;
+#endif
+#ifdef MRL_COMPLETE_WIDTH
+  self->width = MRL_COMPLETE_WIDTH;
+#endif
+#ifdef MRL_USE_COMPL_CACHE
+  self->cache_len = 0;
+#endif
+#ifdef MRL_USE_COMPL_MENU
+  self->menu = -1;
+#endif
+
+#ifdef MRL_USE_CMD
+  self->cmd     = NULL;
+  self->cmd_num = 0;
+#endif
+
+#ifdef MRL_USE_CTRL_C
+  self->sigint = NULL;
+#endif
+
+#ifdef MRL_USE_TICK
+  self->rx      = true; // get time by first mrl_tick() call
+  self->idle_ms = 0;
+  self->idle    = NULL;
+#endif
+
+#ifdef MRL_ENABLE_INIT_PROMPT
+#ifndef MRL_PRINT_ESC_OFF
+  mrl_print(self, "\r\033[K"); // erase all string and go to begin
+#else
+  mrl_print(self, "\r"); // start from begin of line
+#endif // MRL_PRINT_ESC_OFF
+  mrl_terminal_prompt(self);
+  mrl_auto_flush(self);
+#endif
+}
+//-----------------------------------------------------------------------------
+#ifndef MRL_USE_EXT_BUF
+void mrl_init(mrl_t *self, void (*print)(void*, const char*), void *ctx)
+{
+  mrl_init_data(self, print, ctx);
+}
+#else
+void mrl_init_ext(mrl_t *self, const mrl_mem_t *mem,
+                  void (*print)(void*, const char*), void *ctx)
+{
+  self->cmdline   = mem->line;
+  self->line_len  = mem->line_len;
+  self->argv      = mem->argv;
+  self->token_num = mem->token_num;
+
+#ifdef MRL_USE_SHADOW
+  self->shadow = mem->shadow;
+#endif
+
+#if defined(MRL_USE_HISTORY) && !defined(MRL_USE_HIST_SHARED)
+  self->hist.buf = mem->hist;
+  self->hist.len = mem->hist != NULL && mem->hist_len >= mem->line_len ?
+                   mem->hist_len : 0; // history is off
+#ifdef MRL_USE_HIST_INDEX
+  if (sizeof(MRL_HIST_INDEX_TYPE) < sizeof(int) &&
+      self->hist.len > (int) (MRL_HIST_INDEX_TYPE) -1 + 1)
+    self->hist.len = (int) (MRL_HIST_INDEX_TYPE) -1 + 1; // fit to index type
+#endif // MRL_USE_HIST_INDEX
+#endif
+
+  mrl_init_data(self, print, ctx);
+}
+#endif // MRL_USE_EXT_BUF
+//-----------------------------------------------------------------------------
+void mrl_clear(mrl_t *self)
+{
+  mrl_terminal_clear(self);
+  mrl_auto_flush(self);
+}
+//-----------------------------------------------------------------------------
+void mrl_prompt(mrl_t *self)
+{
+  self->cmdline[0] = '\0';
+  self->cmdlen = 0;
+  self->cursor = 0;
+#ifdef MRL_USE_COMPL_CACHE
+  self->cache_len = 0;
+#endif
+#ifdef MRL_USE_COMPL_MENU
+  self->menu = -1;
+#endif
+  mrl_terminal_clear(self);
+  mrl_terminal_prompt(self);
+#ifdef MRL_USE_SHADOW
+  mrl_shadow_reset(self);
+#endif // MRL_USE_SHADOW
+  mrl_auto_flush(self);
+}
+//-----------------------------------------------------------------------------
+void mrl_refresh(mrl_t *self)
+{
+#ifdef MRL_USE_HIST_SEARCH
+  if (self->search)
+  {
+    mrl_search_show(self);
+    mrl_auto_flush(self);
+    return;
+  }
+#endif // MRL_USE_HIST_SEARCH
+  mrl_terminal_clear(self);
+  mrl_terminal_prompt(self);
+  mrl_terminal_print(self, self->cmdline);
+  mrl_terminal_cursor(self, self->cursor);
+#ifdef MRL_USE_SHADOW
+  mrl_shadow_sync(self);
+#endif // MRL_USE_SHADOW
+  mrl_auto_flush(self);
+}
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_PASTE
+void mrl_set_paste(mrl_t *self, bool enable)
+{
+  mrl_print(self, enable ? "\033[?2004h" : "\033[?2004l");
+  mrl_auto_flush(self);
+}
+#endif // MRL_USE_PASTE
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_SNAPSHOT
+int mrl_hist_export(mrl_t *self,
+                    int (*write)(void *ctx, const void *buf, int len),
+                    void *ctx)
+{
+  mrl_hist_t *hist = &self->hist;
+  mrl_snap_t hdr;
+
+  hdr.magic    = MRL_SNAP_MAGIC;
+  hdr.version  = MRL_SNAP_VERSION;
+  hdr.line_len = MRL_LINE_LEN(self);
+  hdr.len      = MRL_HIST_LEN(hist);
+  hdr.begin    = hist->begin;
+  hdr.end      = hist->end;
+  hdr.last     = hist->last;
+  hdr.sum      = 0;
+  hdr.sum = mrl_adler32(mrl_adler32(1, &hdr, sizeof(hdr)),
+                        hist->buf, MRL_HIST_LEN(hist));
+
+  if (write(ctx, &hdr, sizeof(hdr)) != (int) sizeof(hdr) ||
+      write(ctx, hist->buf, MRL_HIST_LEN(hist)) != MRL_HIST_LEN(hist))
+    return -1;
+
+  return mrl_hist_snap_size(self);
+}
+//-----------------------------------------------------------------------------
+bool mrl_hist_snap_check(const void *snap, int size)
+{
+  mrl_snap_t hdr;
+  uint32_t sum;
+
+  if (!mrl_snap_header(snap, size, &hdr)) return false;
+
+  sum = hdr.sum;
+  hdr.sum = 0;
+  return mrl_adler32(mrl_adler32(1, &hdr, sizeof(hdr)),
+                     (const char*) snap + sizeof(hdr), hdr.len) == sum;
+}
+//-----------------------------------------------------------------------------
+bool mrl_hist_import(mrl_t *self, const void *snap, int size)
+{
+  mrl_hist_t *hist = &self->hist;
+  const char *ring = (const char*) snap + sizeof(mrl_snap_t);
+  mrl_snap_t hdr;
+
+  if (!mrl_hist_snap_check(snap, size)) return false;
+  memcpy(&hdr, snap, sizeof(hdr));
+
+  if (hdr.len == (uint32_t) MRL_HIST_LEN(hist) &&
+      hdr.line_len <= (uint32_t) MRL_LINE_LEN(self))
+  { // the same ring buffer: copy image
+    memcpy(hist->buf, ring, hdr.len);
+    hist->begin = hdr.begin;
+    hist->end   = hdr.end;
+    hist->last  = hdr.last;
+    mrl_hist_rebuild(hist);
+  }
+  else
+  { // other ring buffer: save lines (oldest first) by command line buffer
+    void (*journal)(void*, const char*) = hist->journal;
+    void *ctx = hist->ctx;
+    uint32_t i = hdr.begin;
+
+    mrl_hist_init(hist);
+    while (hdr.last != hdr.end && i != hdr.end)
+    {
+#ifdef MRL_USE_HIST_FRONT
+      int len = mrl_front_len(ring, hdr.len, i);
+      if (len < MRL_LINE_LEN(self))
+        mrl_front_get(ring, hdr.len, i, len, self->cmdline, NULL);
+      while (ring[i] != '\0')
+        if (++i == hdr.len) i = 0;
+#else
+      int len = 0;
+      while (ring[i] != '\0')
+      {
+        if (len < MRL_LINE_LEN(self)) self->cmdline[len++] = ring[i];
+        if (++i == hdr.len) i = 0;
+      }
+#endif // MRL_USE_HIST_FRONT
+      if (++i == hdr.len) i = 0;
+
+      if (len < MRL_LINE_LEN(self))
+      { // skip too long lines
+        self->cmdline[len] = '\0';
+        mrl_hist_save(hist, self->cmdline);
+      }
+    }
+    hist->journal = journal;
+    hist->ctx     = ctx;
+
+    self->cmdline[0] = '\0';
+    self->cmdlen = 0;
+    self->cursor = 0;
+#ifdef MRL_USE_COMPL_CACHE
+    self->cache_len = 0;
+#endif
+#ifdef MRL_USE_COMPL_MENU
+    self->menu = -1;
+#endif
+  }
 
-  if (argc > 0 && self->execute != NULL) self->execute(argc, argv);
-  
-  self->cmdline[0] = '\0';
-  self->cmdlen = 0;
-  self->cursor = 0;
-  mrl_terminal_prompt(self);
+  return true;
 }
 //-----------------------------------------------------------------------------
-void mrl_init(mrl_t *self, void (*print)(const char*))
+#ifdef MRL_USE_EXT_BUF
+bool mrl_hist_adopt(mrl_t *self, void *snap, int size)
 {
-#ifdef MRL_USE_HISTORY
-  mrl_hist_init(&self->hist);
-#endif
-
-#ifdef MRL_USE_ESC_SEQ
-  self->escape_seq = MRL_ESC_STOP;
-#endif
-
-#if (defined(MRL_ENDL_CRLF) || defined(MRL_ENDL_LFCR))
-  self->tmpch = '\0';
-#endif
-  
-  self->prompt     = mrl_prompt_default;
-  self->prompt_len = mrl_prompt_default_len;
+  mrl_hist_t *hist = &self->hist;
+  mrl_snap_t hdr;
+
+  if (!mrl_snap_header(snap, size, &hdr) ||
+      hdr.line_len > (uint32_t) MRL_LINE_LEN(self) ||
+      hdr.len < (uint32_t) MRL_LINE_LEN(self))
+    return false;
+
+#ifdef MRL_USE_HIST_INDEX
+  if (sizeof(MRL_HIST_INDEX_TYPE) < sizeof(int) &&
+      hdr.len > (uint32_t) (MRL_HIST_INDEX_TYPE) -1 + 1)
+    return false; // don't fit to index type
+#endif // MRL_USE_HIST_INDEX
+
+  hist->buf   = (char*) snap + sizeof(mrl_snap_t);
+  hist->len   = hdr.len;
+  hist->begin = hdr.begin;
+  hist->end   = hdr.end;
+  hist->last  = hdr.last;
+  mrl_hist_rebuild(hist);
 
-#ifdef MRL_DEBUG_HISTORY
-  memset(self->cmdline, '~', MRL_COMMAND_LINE_LEN);
-#endif
+  return true;
+}
+#endif // MRL_USE_EXT_BUF
+//-----------------------------------------------------------------------------
+int mrl_hist_replay(mrl_t *self, const char *log, int size)
+{
+  void (*journal)(void*, const char*) = self->hist.journal;
+  int i = 0, n = 0;
 
-  self->cmdline[0] = '\0';
-  self->cmdlen = 0;
-  self->cursor = 0;
+  self->hist.journal = NULL; // don't write replayed lines to journal
 
-  self->print = print;
-  self->execute = NULL;
-#ifdef MRL_USE_COMPLETE
-  self->get_completion = NULL;
-#endif
+  while (i < size)
+  {
+    int len = 0;
+    while (i + len < size && log[i + len] != '\0') len++;
+    if (i + len == size) break; // incomplete last line
 
-#ifdef MRL_USE_CTLR_C
-  self->sigint = NULL;
-#endif
+    if (len < MRL_LINE_LEN(self))
+    { // skip too long lines
+      mrl_hist_save(&self->hist, log + i);
+      n++;
+    }
+    i += len + 1;
+  }
 
-#ifdef MRL_ENABLE_INIT_ROMPT
-#ifndef MRL_PRINT_ESC_OFF
-  self->print("\r\033[K"); // erase all string and go to begin
-#else
-  self->print("\r"); // start from begin of line
-#endif // MRL_PRINT_ESC_OFF
-  mrl_terminal_prompt(self);
-#endif
+  self->hist.journal = journal;
+  return n;
 }
+#endif // MRL_USE_HIST_SNAPSHOT
 //-----------------------------------------------------------------------------
-void mrl_clear(mrl_t *self)
+#ifdef MRL_USE_ESC_SEQ
+// ESC sequence parser transition (next state and action)
+#define MRL_ESC_T(state, action) \
+  (((MRL_ESC_A_ ## action) << 4) | (MRL_ESC_ ## state))
+
+// ESC sequence parser transition table [state][char class]
+static const unsigned char mrl_esc_table[MRL_ESC_STATES][MRL_ESC_CLASSES] = {
+  // DIGIT               SEMI                  PRIV
+  // INTER               LBR '['               SS3 'O'
+  // FINAL               DEL                   CTRL
+  { // MRL_ESC_STOP (not used)
+    MRL_ESC_T(STOP, ABORT),   MRL_ESC_T(STOP, ABORT),   MRL_ESC_T(STOP, ABORT),
+    MRL_ESC_T(STOP, ABORT),   MRL_ESC_T(STOP, ABORT),   MRL_ESC_T(STOP, ABORT),
+    MRL_ESC_T(STOP, ABORT),   MRL_ESC_T(STOP, ABORT),   MRL_ESC_T(STOP, ABORT)
+  },
+  { // MRL_ESC_START: ESC
+    MRL_ESC_T(STOP, ALT),     MRL_ESC_T(STOP, ALT),     MRL_ESC_T(STOP, ALT),
+    MRL_ESC_T(STOP, ALT),     MRL_ESC_T(CSI, CLEAR),    MRL_ESC_T(SS3, CLEAR),
+    MRL_ESC_T(STOP, ALT),     MRL_ESC_T(STOP, ALT),     MRL_ESC_T(STOP, ABORT)
+  },
+  { // MRL_ESC_CSI: ESC [ parameters
+    MRL_ESC_T(CSI, PARAM),    MRL_ESC_T(CSI, NEXT),     MRL_ESC_T(IGNORE, NONE),
+    MRL_ESC_T(INTER, NONE),   MRL_ESC_T(IGNORE, NONE),  MRL_ESC_T(STOP, FINAL),
+    MRL_ESC_T(STOP, FINAL),   MRL_ESC_T(CSI, NONE),     MRL_ESC_T(STOP, ABORT)
+  },
+  { // MRL_ESC_SS3: ESC O parameters
+    MRL_ESC_T(SS3, PARAM),    MRL_ESC_T(SS3, NEXT),     MRL_ESC_T(IGNORE, NONE),
+    MRL_ESC_T(IGNORE, NONE),  MRL_ESC_T(STOP, FINAL),   MRL_ESC_T(STOP, FINAL),
+    MRL_ESC_T(STOP, FINAL),   MRL_ESC_T(SS3, NONE),     MRL_ESC_T(STOP, ABORT)
+  },
+  { // MRL_ESC_INTER: intermediate chars
+    MRL_ESC_T(IGNORE, NONE),  MRL_ESC_T(IGNORE, NONE),  MRL_ESC_T(IGNORE, NONE),
+    MRL_ESC_T(INTER, NONE),   MRL_ESC_T(STOP, NONE),    MRL_ESC_T(STOP, NONE),
+    MRL_ESC_T(STOP, NONE),    MRL_ESC_T(INTER, NONE),   MRL_ESC_T(STOP, ABORT)
+  },
+  { // MRL_ESC_IGNORE: unknown sequence
+    MRL_ESC_T(IGNORE, NONE),  MRL_ESC_T(IGNORE, NONE),  MRL_ESC_T(IGNORE, NONE),
+    MRL_ESC_T(IGNORE, NONE),  MRL_ESC_T(STOP, NONE),    MRL_ESC_T(STOP, NONE),
+    MRL_ESC_T(STOP, NONE),    MRL_ESC_T(IGNORE, NONE),  MRL_ESC_T(STOP, ABORT)
+  }
+};
+
+// CSI/SS3 final char => key (ESC[A, ESC OA, ESC[1;5C, ...)
+static const char mrl_esc_final_map['Z' - 'A' + 1] = {
+  ['A' - 'A'] = MRL_ESC_KEY_UP,
+  ['B' - 'A'] = MRL_ESC_KEY_DOWN,
+  ['C' - 'A'] = MRL_ESC_KEY_RIGHT,
+  ['D' - 'A'] = MRL_ESC_KEY_LEFT,
+  ['F' - 'A'] = MRL_ESC_KEY_END,
+  ['H' - 'A'] = MRL_ESC_KEY_HOME,
+  ['Z' - 'A'] = MRL_ESC_KEY_BACKTAB
+};
+
+// ESC[n~ parameter => key
+static const short mrl_esc_tilde_map[][2] = {
+  { 1, MRL_ESC_KEY_HOME   },
+  { 3, MRL_ESC_KEY_DELETE },
+  { 4, MRL_ESC_KEY_END    },
+  { 5, MRL_ESC_KEY_PGUP   },
+  { 6, MRL_ESC_KEY_PGDN   },
+  { 7, MRL_ESC_KEY_HOME   }, // rxvt
+  { 8, MRL_ESC_KEY_END    }, // rxvt
+#ifdef MRL_USE_PASTE
+  { 200, MRL_ESC_KEY_PASTE },
+#endif // MRL_USE_PASTE
+};
+//-----------------------------------------------------------------------------
+// get class of ESC sequence char
+INLINE int mrl_esc_class(char ch)
 {
-#ifndef MRL_PRINT_ESC_OFF
-  self->print("\r\033[K");
-#else
-  self->print("\r"); // FIXME
-#endif // MRL_PRINT_ESC_OFF
+  unsigned char c = (unsigned char) ch;
+  if (c >= '0' && c <= '9') return MRL_ESC_C_DIGIT;
+  if (c == ';' || c == ':') return MRL_ESC_C_SEMI;
+  if (c >= '<' && c <= '?') return MRL_ESC_C_PRIV;
+  if (c >= ' ' && c <= '/') return MRL_ESC_C_INTER;
+  if (c == '[')             return MRL_ESC_C_LBR;
+  if (c == 'O')             return MRL_ESC_C_SS3;
+  if (c >= '@' && c <= '~') return MRL_ESC_C_FINAL;
+  if (c == MRL_KEY_DEL)     return MRL_ESC_C_DEL;
+  return MRL_ESC_C_CTRL;
 }
 //-----------------------------------------------------------------------------
-void mrl_prompt(mrl_t *self)
+// decode CSI/SS3 sequence by final char
+static int mrl_esc_final(const mrl_t *self, char ch)
 {
-  self->cmdline[0] = '\0';
-  self->cmdlen = 0;
-  self->cursor = 0;
-  mrl_clear(self);
-  mrl_terminal_prompt(self);
+  int key = MRL_ESC_KEY_NONE;
+
+  if (ch == '~')
+  {
+    unsigned i;
+    for (i = 0; i < sizeof(mrl_esc_tilde_map) / sizeof(mrl_esc_tilde_map[0]);
+         i++)
+      if (mrl_esc_tilde_map[i][0] == self->escape_arg[0])
+        return mrl_esc_tilde_map[i][1];
+  }
+  else if (ch >= 'A' && ch <= 'Z')
+  {
+    key = mrl_esc_final_map[ch - 'A'];
+    if (self->escape_arg[1] == MRL_ESC_MOD_CTRL ||
+        self->escape_arg[1] == MRL_ESC_MOD_ALT)
+    { // Ctrl+arrow or Alt+arrow
+      if      (key == MRL_ESC_KEY_RIGHT) key = MRL_ESC_KEY_WORD_RIGHT;
+      else if (key == MRL_ESC_KEY_LEFT)  key = MRL_ESC_KEY_WORD_LEFT;
+    }
+  }
+
+  return key;
 }
 //-----------------------------------------------------------------------------
-void mrl_refresh(mrl_t *self)
+// decode ESC + char (Alt+char)
+INLINE int mrl_esc_alt(char ch)
 {
-  mrl_clear(self);
-  mrl_terminal_prompt(self);
-  mrl_terminal_print(self, self->cmdline);
-  mrl_terminal_cursor(self, self->cursor);
+  if (ch == 'b')         return MRL_ESC_KEY_WORD_LEFT;
+  if (ch == 'f')         return MRL_ESC_KEY_WORD_RIGHT;
+  if (ch == MRL_KEY_DEL) return MRL_ESC_KEY_ALT_BS;
+  return MRL_ESC_KEY_NONE;
 }
 //-----------------------------------------------------------------------------
-#ifdef MRL_USE_ESC_SEQ
-// handling escape sequences
-static void mrl_escape_process(mrl_t *self, char ch)
+// run key decoded from ESC sequence
+static void mrl_escape_key(mrl_t *self, int key)
 {
-  if (ch == '[')
-    self->escape_seq = MRL_ESC_BRACKET;
-  else if (ch == MRL_KEY_DEL)
-  { // Alt+BACKSPACE
-    mrl_del_before_cursor(self);
-    self->escape_seq = MRL_ESC_STOP;
-  }
-  else if (self->escape_seq == MRL_ESC_BRACKET)
+#ifdef MRL_USE_COMPL_MENU
+  if (key != MRL_ESC_KEY_BACKTAB)
+    self->menu = -1; // any other key stop menu completion
+#endif // MRL_USE_COMPL_MENU
+
+  switch (key)
   {
-    if (ch == 'A')
-    { // cursor UP
+    case MRL_ESC_KEY_UP: // cursor UP
 #ifdef MRL_USE_HISTORY
 #  ifdef MRL_ECHO_OFF
-      self->print("\n");
+      mrl_print(self, "\n");
 #  endif // MRL_ECHO_OFF
       mrl_hist(self, MRL_HIST_BACKWARD);
-#endif // MRL_USE_HISTORY 
-      self->escape_seq = MRL_ESC_STOP;
-    }
-    else if (ch == 'B')
-    { // cursor DOWN
+#endif // MRL_USE_HISTORY
+      break;
+
+    case MRL_ESC_KEY_DOWN: // cursor DOWN
 #ifdef MRL_USE_HISTORY
       mrl_hist(self, MRL_HIST_FORWARD);
-#endif // MRL_USE_HISTORY 
-      self->escape_seq = MRL_ESC_STOP;
-    }
-    else if (ch == 'C')
-    { // cursor RIGHT
+#endif // MRL_USE_HISTORY
+      break;
+
+    case MRL_ESC_KEY_PGUP: // PAGE UP - oldest history line
+#ifdef MRL_USE_HISTORY
+#  ifdef MRL_ECHO_OFF
+      mrl_print(self, "\n");
+#  endif // MRL_ECHO_OFF
+      mrl_hist(self, MRL_HIST_FIRST);
+#endif // MRL_USE_HISTORY
+      break;
+
+    case MRL_ESC_KEY_PGDN: // PAGE DOWN - newest history line
+#ifdef MRL_USE_HISTORY
+      mrl_hist(self, MRL_HIST_LAST);
+#endif // MRL_USE_HISTORY
+      break;
+
+    case MRL_ESC_KEY_RIGHT: // cursor RIGHT
       mrl_cursor_forward(self);
-      self->escape_seq = MRL_ESC_STOP;
-    }
-    else if (ch == 'D')
-    { // cursor LEFT
+      break;
+
+    case MRL_ESC_KEY_LEFT: // cursor LEFT
       mrl_cursor_back(self);
-      self->escape_seq = MRL_ESC_STOP;
-    }
-    else if (ch == 'H')
-    { // HOME
+      break;
+
+    case MRL_ESC_KEY_WORD_RIGHT: // Ctrl+RIGHT or Alt+F
+      mrl_cursor_word_forward(self);
+      break;
+
+    case MRL_ESC_KEY_WORD_LEFT: // Ctrl+LEFT or Alt+B
+      mrl_cursor_word_back(self);
+      break;
+
+    case MRL_ESC_KEY_HOME: // HOME
       mrl_cursor_home(self);
-      self->escape_seq = MRL_ESC_STOP;
-    } 
-    else if (ch == 'F')
-    { // END
+      break;
+
+    case MRL_ESC_KEY_END: // END
 #ifdef MRL_ECHO_OFF
       mrl_terminal_cursor_back(self);
       mrl_terminal_print(self, self->cmdline + self->cursor);
 #endif // MRL_ECHO_OFF
       mrl_cursor_end(self);
-      self->escape_seq = MRL_ESC_STOP;
-    } 
-    else if (ch == '7' || ch == '1')
-      self->escape_seq = MRL_ESC_HOME;
-    else if (ch == '8')
-      self->escape_seq = MRL_ESC_END;
-    else if (ch == '3')
-      self->escape_seq = MRL_ESC_DELETE;
-    else
-      self->escape_seq = MRL_ESC_STOP; // unknown escape sequence, stop
+      break;
+
+    case MRL_ESC_KEY_DELETE: // DELETE
+      mrl_delete(self);
+      break;
+
+    case MRL_ESC_KEY_ALT_BS: // Alt+BACKSPACE
+      mrl_del_before_cursor(self);
+      break;
+
+#ifdef MRL_USE_PASTE
+    case MRL_ESC_KEY_PASTE: // bracketed paste begin
+      self->paste    = 1;
+      self->paste_cr = false;
+      self->defer    = true; // one redraw at end of paste
+      break;
+#endif // MRL_USE_PASTE
+
+#ifdef MRL_USE_COMPL_MENU
+    case MRL_ESC_KEY_BACKTAB: // Shift+TAB - previous variant
+      if (self->menu >= 0 && self->cache_len != 0)
+        mrl_menu_step(self, -1);
+      break;
+#endif // MRL_USE_COMPL_MENU
   }
-  else if (ch == '~')
+}
+//-----------------------------------------------------------------------------
+// handling escape sequences by one char
+// (return false if char abort sequence and must be handled as usual key)
+static bool mrl_escape_process(mrl_t *self, char ch)
+{
+  int t = mrl_esc_table[(int) self->escape_seq][mrl_esc_class(ch)];
+  int key = MRL_ESC_KEY_NONE;
+  short *arg;
+
+  switch (t >> 4)
   {
-    if (self->escape_seq == MRL_ESC_HOME)
-    { // HOME
-      mrl_cursor_home(self);
-      self->escape_seq = MRL_ESC_STOP;
-    }
-    else if (self->escape_seq == MRL_ESC_END)
-    { // END
-#ifdef MRL_ECHO_OFF
-      mrl_terminal_cursor_back(self);
-      mrl_terminal_print(self, self->cmdline + self->cursor);
-#endif // MRL_ECHO_OFF
-      mrl_cursor_end(self);
+    case MRL_ESC_A_CLEAR:
+      self->escape_argn = 0;
+      self->escape_arg[0] = self->escape_arg[1] = 0;
+      break;
+
+    case MRL_ESC_A_PARAM:
+      if (self->escape_argn < MRL_ESC_ARGS)
+      {
+        arg = &self->escape_arg[(int) self->escape_argn];
+        if (*arg <= MRL_ESC_ARG_MAX)
+          *arg = *arg * 10 + (ch - '0');
+      }
+      break;
+
+    case MRL_ESC_A_NEXT:
+      if (self->escape_argn < MRL_ESC_ARGS)
+        self->escape_argn++;
+      break;
+
+    case MRL_ESC_A_FINAL:
+      key = mrl_esc_final(self, ch);
+      break;
+
+    case MRL_ESC_A_ALT:
+      key = mrl_esc_alt(ch);
+      break;
+
+    case MRL_ESC_A_ABORT:
       self->escape_seq = MRL_ESC_STOP;
+      return false;
+  }
+
+  self->escape_seq = t & 0x0F;
+
+  if (key != MRL_ESC_KEY_NONE)
+    mrl_escape_key(self, key);
+
+  return true;
+}
+#endif // MRL_USE_ESC_SEQ
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_PASTE
+// handle one char of bracketed paste (insert it as is until ESC[201~)
+static void mrl_paste_process(mrl_t *self, int ch)
+{
+  static const char end[] = "\033[201~";
+  bool cr = self->paste_cr;
+
+  if (self->paste == MRL_PASTE_SKIP ||
+      (self->paste > 1 && ch != end[self->paste - 1]))
+  { // other ESC sequence, drop it up to final char
+    if (MRL_IS_CONTROL_CHAR(ch))
+      self->paste = 1; // control char abort sequence
+    else
+    {
+      if (self->paste == 2) // ESC + char (SS3 - ESC + 'O' + char)
+        self->paste = (ch == 'O') ? MRL_PASTE_SKIP : 1;
+      else // CSI: skip parameters and intermediate chars
+        self->paste = MRL_IS_ESC_FINAL(ch) ? 1 : MRL_PASTE_SKIP;
+      return;
     }
-    else if (self->escape_seq == MRL_ESC_DELETE)
-    { // DELETE
-      mrl_delete(self);
-      self->escape_seq = MRL_ESC_STOP;
+  }
+
+  if (ch == end[self->paste - 1])
+  {
+    if (end[self->paste++] == '\0')
+    { // end of paste
+      self->paste = 0;
+      mrl_commit(self);
     }
+    return;
   }
-  else if (ch == 'O')
-    self->escape_seq = MRL_ESC_O;
-  else if (self->escape_seq == MRL_ESC_O && ch == 'F')
-  { // END
-#ifdef MRL_ECHO_OFF
-    mrl_terminal_cursor_back(self);
-    mrl_terminal_print(self, self->cmdline + self->cursor);
-#endif // MRL_ECHO_OFF
-    mrl_cursor_end(self);
-    self->escape_seq = MRL_ESC_STOP;
+
+  self->paste_cr = (ch == MRL_KEY_CR);
+  if (ch == MRL_KEY_CR || ch == MRL_KEY_LF)
+  {
+    if (ch == MRL_KEY_LF && cr) return; // CR+LF is one new line
+#if defined(MRL_PASTE_NL_SPACE)
+    mrl_insert_chr(self, ' ');
+#elif defined(MRL_PASTE_NL_EXEC)
+    mrl_commit(self);
+    mrl_new_line_handler(self);
+    self->defer = true;
+#endif
   }
-  else
-    self->escape_seq = MRL_ESC_STOP; // unknown escape sequence, stop
+  else if (ch == MRL_KEY_HT)
+    mrl_insert_chr(self, ' ');
+  else if (!MRL_IS_CONTROL_CHAR(ch) && ch != MRL_KEY_DEL)
+    mrl_insert_chr(self, ch);
 }
-#endif // MRL_USE_ESC_SEQ
+#endif // MRL_USE_PASTE
 //-----------------------------------------------------------------------------
-int mrl_insert_char(mrl_t *self, int ch)
+// handle one input char (return non zero key code if Ctrl+KEY pressed)
+static int mrl_insert_key(mrl_t *self, int ch)
 {
-#ifdef MRL_USE_ESC_SEQ
-  if (self->escape_seq)
+#ifdef MRL_USE_TICK
+  self->rx = true;
+#endif
+
+#ifdef MRL_USE_PASTE
+  if (self->paste)
   {
-    mrl_escape_process(self, ch);
+    mrl_paste_process(self, ch);
     return 0;
   }
 #endif
 
+#ifdef MRL_USE_ESC_SEQ
+  if (self->escape_seq && mrl_escape_process(self, ch))
+    return 0;
+#endif
+
+#ifdef MRL_USE_COMPL_MENU
+  if (ch != MRL_KEY_HT && ch != MRL_KEY_ESC)
+    self->menu = -1; // any other key stop menu completion
+#endif
+
+#ifdef MRL_USE_HIST_SEARCH
+  if (self->search && mrl_search_key(self, ch))
+    return 0;
+#endif
+
   switch (ch)
   {
 #if defined(MRL_ENDL_CR)
@@ -897,34 +3266,22 @@ int mrl_insert_char(mrl_t *self, int ch)
       break;
 
     case MRL_KEY_VT:  // Ctrl+K
-#ifdef MRL_ECHO_OFF
-      self->print("\n");
-#endif // MRL_ECHO_OFF
-#ifndef MRL_PRINT_ESC_OFF
-      self->print("\033[K");
-      self->cmdlen = self->cursor;
-      self->cmdline[self->cmdlen] = '\0';
-#else
-      mrl_terminal_newline(self);
-      mrl_terminal_prompt(self);
-      self->cmdlen = self->cursor;
-      self->cmdline[self->cmdlen] = '\0';
-      mrl_terminal_print(self, self->cmdline);
-      mrl_terminal_cursor(self, self->cursor);
-      break;
-#endif // MRL_PRINT_ESC_OFF
+      mrl_del_after_cursor(self);
       break;
 
     case MRL_KEY_BEL: // Ctrl+G
 #ifndef MRL_PRINT_ESC_OFF
-      self->print("\r");
-      self->print("\033[K");
+      mrl_print(self, "\r");
+      mrl_print(self, "\033[K");
 #else
       mrl_terminal_newline(self);
 #endif // MRL_PRINT_ESC_OFF
       mrl_terminal_prompt(self);
       self->cmdlen = self->cursor = 0;
       self->cmdline[0] = '\0';
+#ifdef MRL_USE_SHADOW
+      mrl_shadow_reset(self);
+#endif // MRL_USE_SHADOW
       break;
 
     case MRL_KEY_ENQ: // Ctrl+E
@@ -961,29 +3318,44 @@ int mrl_insert_char(mrl_t *self, int ch)
       break;
 
     case MRL_KEY_DC2: // Ctrl+R
+#ifdef MRL_USE_HIST_SEARCH
+      mrl_search_start(self);
+#else
       mrl_terminal_newline(self);
       mrl_terminal_prompt(self);
       //mrl_terminal_cursor(self, 0);
       mrl_terminal_print(self, self->cmdline);
       mrl_terminal_cursor(self, self->cursor);
+#ifdef MRL_USE_SHADOW
+      mrl_shadow_sync(self);
+#endif // MRL_USE_SHADOW
+#endif // MRL_USE_HIST_SEARCH
       break;
 
     case MRL_KEY_ETX: // Ctrl+C
 #ifdef MRL_USE_CTRL_C
-      if (self->sigint != NULL) self->sigint();
+      if (self->sigint != NULL)
+      {
+        mrl_flush(self);
+        self->sigint(self->ctx);
+        self->tpos = MRL_TPOS_UNKNOWN;
+      }
 #endif // MRL_USE_CTRL_C
       return MRL_KEY_ETX;
 
     case MRL_KEY_FF: // Ctrl+L
 #ifndef MRL_PRINT_ESC_OFF
-      self->print("\033[2J"  // ESC seq for clear entire screen
+      mrl_print(self, "\033[2J"  // ESC seq for clear entire screen
                   "\033[H"); // ESC seq for move cursor at left-top corner
 #else
-      self->print(MRL_ENDL); // go to new line only
+      mrl_print(self, MRL_ENDL); // go to new line only
 #endif // MRL_PRINT_ESC_OFF
       mrl_terminal_prompt(self);
       mrl_terminal_print(self, self->cmdline);
       mrl_terminal_cursor(self, self->cursor);
+#ifdef MRL_USE_SHADOW
+      mrl_shadow_sync(self);
+#endif // MRL_USE_SHADOW
       break;
     
     case MRL_KEY_EOT: // Ctrl+D
@@ -1006,6 +3378,139 @@ int mrl_insert_char(mrl_t *self, int ch)
   
   return 0;
 }
+//-----------------------------------------------------------------------------
+int mrl_insert_char(mrl_t *self, int ch)
+{
+  int rv = mrl_insert_key(self, ch);
+  mrl_auto_flush(self);
+  return rv;
+}
+//-----------------------------------------------------------------------------
+#ifndef MRL_ECHO_OFF
+// check key may be handled with deferred rendering (edit and move keys)
+INLINE bool mrl_key_deferrable(const mrl_t *self, int ch)
+{
+#ifdef MRL_USE_ESC_SEQ
+  if (self->escape_seq && !MRL_IS_CONTROL_CHAR(ch))
+    return true; // control char abort ESC sequence
+#endif
+#ifdef MRL_USE_PASTE
+  if (self->paste) return true; // new line inside paste commit itself
+#endif
+#ifdef MRL_USE_HIST_SEARCH
+  if (self->search) return false; // search mode redraw line itself
+#endif
+
+  switch (ch)
+  {
+    case MRL_KEY_ESC: // ESC
+    case MRL_KEY_NAK: // Ctrl+U
+    case MRL_KEY_VT:  // Ctrl+K
+    case MRL_KEY_ENQ: // Ctrl+E
+    case MRL_KEY_SOH: // Ctrl+A
+    case MRL_KEY_ACK: // Ctrl+F
+    case MRL_KEY_STX: // Ctrl+B
+    case MRL_KEY_DLE: // Ctrl+P
+    case MRL_KEY_SO:  // Ctrl+N
+    case MRL_KEY_DEL: // BACKSPACE
+    case MRL_KEY_BS:  // CTLR+H
+      return true;
+
+    default:
+      return !MRL_IS_CONTROL_CHAR(ch);
+  }
+}
+#endif // !MRL_ECHO_OFF
+//-----------------------------------------------------------------------------
+int mrl_insert_chars(mrl_t *self, const char *buf, int *len)
+{
+  int i, rv = 0;
+  for (i = 0; i < *len && rv == 0; i++)
+  {
+#ifndef MRL_ECHO_OFF
+    if (mrl_key_deferrable(self, (unsigned char) buf[i]))
+      self->defer = true;
+    else if (self->defer)
+      mrl_commit(self); // show changes before newline, callbacks etc.
+#endif // !MRL_ECHO_OFF
+    rv = mrl_insert_key(self, (unsigned char) buf[i]);
+  }
+#ifndef MRL_ECHO_OFF
+  if (self->defer)
+    mrl_commit(self);
+#endif // !MRL_ECHO_OFF
+  mrl_auto_flush(self);
+  *len = i;
+  return rv;
+}
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_TICK
+int mrl_tick(mrl_t *self, unsigned now)
+{
+  int rv = 0;
+
+  if (self->rx)
+  { // input received after last call
+    self->rx = false;
+    self->rx_time = self->idle_time = now;
+    return 0;
+  }
+
+#ifdef MRL_USE_ESC_SEQ
+  if (self->escape_seq != MRL_ESC_STOP &&
+      now - self->rx_time >= MRL_ESC_TIMEOUT)
+  {
+    if (self->escape_seq == MRL_ESC_START)
+      rv = MRL_KEY_ESC; // bare ESC
+    self->escape_seq = MRL_ESC_STOP; // drop half-received sequence
+  }
+#endif // MRL_USE_ESC_SEQ
+
+#ifdef MRL_USE_PASTE
+  if (self->paste && now - self->rx_time >= MRL_PASTE_TIMEOUT)
+  { // end of paste lost
+    self->paste = 0;
+    mrl_commit(self);
+  }
+#endif // MRL_USE_PASTE
+
+  if (self->idle != NULL && self->idle_ms != 0 &&
+      now - self->idle_time >= self->idle_ms)
+  {
+    self->idle_time = now;
+    mrl_flush(self);
+    self->idle(self->ctx);
+    self->tpos = MRL_TPOS_UNKNOWN; // callback may print something
+  }
+
+  mrl_auto_flush(self);
+  return rv;
+}
+#endif // MRL_USE_TICK
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_RXQ
+int mrl_process(mrl_t *self)
+{
+  int rv = 0;
+  mrl_rxq_index_t tail = self->rxq_tail;
+  mrl_rxq_index_t head = MRL_RXQ_LOAD(&self->rxq_head);
+
+  while (tail != head && rv == 0)
+  { // handle continuous part of ring buffer by one call
+    int pos = tail & (MRL_RXQ_LEN - 1);
+    int len = (mrl_rxq_index_t) (head - tail);
+    if (len > MRL_RXQ_LEN - pos)
+      len = MRL_RXQ_LEN - pos;
+
+    rv = mrl_insert_chars(self, (const char*) self->rxq + pos, &len);
+
+    tail += len;
+    MRL_RXQ_STORE(&self->rxq_tail, tail);
+  }
+
+  return rv;
+}
+#endif // MRL_USE_RXQ
 //----------------------------------------------------------------------------
 #if defined(MRL_UINT2STR) || defined(MRL_INT2STR) || !defined(MRL_USE_LIBC_STDIO)
 int mrl_uint2str(unsigned value, char *buf)
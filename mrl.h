@@ -9,32 +9,218 @@
 //-----------------------------------------------------------------------------
 #include "mrl_conf.h"
 #include <stdbool.h>
+#ifdef MRL_USE_HIST_SNAPSHOT
+#include <stdint.h>
+#endif
 //-----------------------------------------------------------------------------
 #ifndef INLINE
 #  define INLINE static inline
 #endif
 //-----------------------------------------------------------------------------
+#ifdef MRL_USE_RXQ
+// RX queue index type
+typedef MRL_RXQ_INDEX mrl_rxq_index_t;
+
+// load/store RX queue index shared between interrupt and main loop
+#if defined(__GNUC__)
+#  define MRL_RXQ_LOAD(ptr)       __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#  define MRL_RXQ_STORE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#else
+#  define MRL_RXQ_LOAD(ptr)       (*(ptr)) // volatile (single core only)
+#  define MRL_RXQ_STORE(ptr, val) (*(ptr) = (val))
+#endif
+#endif // MRL_USE_RXQ
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_SHARED
+// atomic access to sequence number of shared history
+#if defined(__GNUC__)
+#  define MRL_SEQ_LOAD(ptr)          __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#  define MRL_SEQ_STORE(ptr, val)    __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#  define MRL_SEQ_CAS(ptr, old, val) \
+     __atomic_compare_exchange_n(ptr, old, val, false, \
+                                 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)
+#  define MRL_SEQ_FENCE_ACQ()        __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#  define MRL_SEQ_FENCE_REL()        __atomic_thread_fence(__ATOMIC_RELEASE)
+#else // volatile (single core, lines are saved from one context only)
+#  define MRL_SEQ_LOAD(ptr)          (*(ptr))
+#  define MRL_SEQ_STORE(ptr, val)    (*(ptr) = (val))
+#  define MRL_SEQ_CAS(ptr, old, val) (*(ptr) == *(old) ? (*(ptr) = (val), 1) : 0)
+#  define MRL_SEQ_FENCE_ACQ()
+#  define MRL_SEQ_FENCE_REL()
+#endif
+// wait in spin loop while other object is saving line (define it as
+// sched_yield() or RTOS yield if writers may preempt each other on one core)
+#ifndef MRL_SEQ_PAUSE
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#  define MRL_SEQ_PAUSE() __builtin_ia32_pause()
+#elif defined(__GNUC__) && (defined(__aarch64__) || defined(__ARM_ARCH_7A__))
+#  define MRL_SEQ_PAUSE() __asm__ __volatile__ ("yield")
+#else
+#  define MRL_SEQ_PAUSE()
+#endif
+#endif // !MRL_SEQ_PAUSE
+#endif // MRL_USE_HIST_SHARED
+//-----------------------------------------------------------------------------
 #ifdef MRL_USE_HISTORY
+#ifdef MRL_USE_HIST_SHARED
+// history ring buffer shared by many MicroRL objects (static or zeroed);
+// lines are addressed by free running indexes, so index of line is valid
+// while line is in ring buffer (index >= begin); one object saves line at
+// a time (odd 'seq' is reserved by atomic compare and swap, other writers
+// wait in short spin loop), readers check
+// 'seq' after search of line and 'begin' after copying of line
+typedef struct {
+  char buf[MRL_RING_HISTORY_LEN]; // ring buffer (lines with '\0')
+  volatile unsigned seq;   // sequence number (odd - line is being saved)
+  volatile unsigned begin; // free running index of oldest line
+  volatile unsigned end;   // free running index of future line
+  volatile unsigned last;  // free running index of newest line
+} mrl_hist_shared_t;
+
+// history cursor of MicroRL object (private part of shared history)
+typedef struct {
+  mrl_hist_shared_t *shared; // shared history (NULL - history is off)
+  unsigned pos;   // free running index of current line
+  unsigned saved; // free running index of line saved on enter (first_save)
+  int cur;        // index of current line in buffer (-1 - not in history)
+  int line_len;   // command line buffer size (longer lines are cut)
+  bool first_save;
+#ifdef MRL_USE_HIST_PREFIX
+  int prefix; // length of prefix for UP/DOWN (cursor on first UP)
+#endif // MRL_USE_HIST_PREFIX
+} mrl_hist_t;
+#else
 // history struct, contain internal variable
 // history store in static ring buffer for memory saving
 typedef struct {
+#ifdef MRL_USE_EXT_BUF
+  char *buf; // ring buffer (caller-owned)
+  int len;   // ring buffer size (0 - history is off)
+#else
   char buf[MRL_RING_HISTORY_LEN]; // ring buffer
-  int begin; // begin index of olderst line
+#endif // MRL_USE_EXT_BUF
+  int begin; // begin index of oldest line
   int end;   // end index (index of future line) 
   int cur;   // index of current string in buffer
   int last;  // index of last string in buffer
   bool first_save;
+#ifdef MRL_USE_HIST_PREFIX
+  int prefix; // length of prefix for UP/DOWN (cursor on first UP)
+#endif // MRL_USE_HIST_PREFIX
+#ifdef MRL_USE_HIST_INDEX
+  MRL_HIST_INDEX_TYPE idx[MRL_HIST_INDEX_LEN]; // ring of lines begin index
+  int first; // index slot of oldest line
+  int count; // number of lines in history
+  int n;     // number of current line (0 - oldest)
+#endif // MRL_USE_HIST_INDEX
+#ifdef MRL_USE_HIST_DEDUP
+  MRL_HIST_DEDUP_TYPE hash[MRL_HIST_DEDUP_LEN]; // hashes of lines (0 - free)
+  int hashes; // number of hashes in table
+#endif // MRL_USE_HIST_DEDUP
+#ifdef MRL_USE_HIST_SNAPSHOT
+  // ptr to 'journal' callback (optional, called for each saved line)
+  void (*journal) (void *ctx, const char *str);
+  void *ctx; // user context (copy of mrl_t::ctx)
+#endif // MRL_USE_HIST_SNAPSHOT
 } mrl_hist_t;
+#endif // MRL_USE_HIST_SHARED
 #endif // MRL_USE_HISTORY
 //-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_SNAPSHOT
+#define MRL_SNAP_MAGIC   0x484C524DUL // "MRLH"
+#ifdef MRL_USE_HIST_FRONT
+#define MRL_SNAP_VERSION 0x101 // front-coded ring buffer
+#else
+#define MRL_SNAP_VERSION 1
+#endif // MRL_USE_HIST_FRONT
+
+// history snapshot header (followed by image of ring buffer, len bytes);
+// snapshot may be read by the same platform only (native byte order)
+typedef struct {
+  uint32_t magic;    // MRL_SNAP_MAGIC
+  uint32_t version;  // MRL_SNAP_VERSION
+  uint32_t line_len; // command line buffer size of writer
+  uint32_t len;      // ring buffer size
+  uint32_t begin;    // index of oldest line
+  uint32_t end;      // index of future line
+  uint32_t last;     // index of last line
+  uint32_t sum;      // Adler-32 of header (with sum = 0) and ring buffer
+} mrl_snap_t;
+#endif // MRL_USE_HIST_SNAPSHOT
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_EXT_BUF
+// caller-owned memory for one MicroRL object (see mrl_init_ext())
+typedef struct {
+  char *line;     // command line buffer
+  int line_len;   // command line buffer size (max number of chars + 1)
+  char *shadow;   // shadow buffer, line_len bytes (MRL_USE_SHADOW only,
+                  // NULL - full redraw of command line on each change)
+  char *hist;     // history ring buffer (MRL_USE_HISTORY, NULL - no history)
+  int hist_len;   // history ring buffer size (must be >= line_len)
+  char **argv;    // tokens array, token_num + 2 pointers
+  int token_num;  // max number of tokens in command line
+} mrl_mem_t;
+#endif // MRL_USE_EXT_BUF
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_CMD
+// record of command tree (command or option), table is ended by MRL_CMD_END;
+// records must be sorted by 'parent' and then by 'name' (strcmp order),
+// so all options of one command are neighbours (see mrl_set_cmd())
+typedef struct mrl_cmd_ mrl_cmd_t;
+struct mrl_cmd_ {
+  short id;     // ID in tree (>=0, unique)
+  short parent; // parent ID for options (or -1 for root)
+  // handler: ctx - user context, argc/argv - tokens after command/option name
+  void (*fn)(void *ctx, int argc, char * const argv[], const mrl_cmd_t *cmd);
+  const char *name; // command/option name
+#ifdef MRL_USE_CMD_HELP
+  const char *args; // arguments for help
+  const char *help; // help (description) string
+#endif // MRL_USE_CMD_HELP
+};
+
+// one record of command tree ('args' and 'help' are dropped if not used)
+#ifdef MRL_USE_CMD_HELP
+#  define MRL_CMD(id, parent, fn, name, args, help) \
+   { id, parent, fn, name, args, help },
+#else
+#  define MRL_CMD(id, parent, fn, name, args, help) \
+   { id, parent, fn, name },
+#endif // MRL_USE_CMD_HELP
+
+// end of command tree
+#define MRL_CMD_END MRL_CMD(-1, -1, NULL, NULL, NULL, NULL)
+#endif // MRL_USE_CMD
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_COMPLETE
+// completion state (see mrl_set_compl_cb() and mrl_compl_add())
+typedef struct mrl_compl_ mrl_compl_t;
+#endif // MRL_USE_COMPLETE
+//-----------------------------------------------------------------------------
 // microrl struct, contain internal library data
 typedef struct {
 #ifdef MRL_USE_HISTORY
   mrl_hist_t hist; // history object
 #endif
 
+#ifdef MRL_USE_HIST_SEARCH
+  bool search;       // reverse history search mode (Ctrl+R)
+  bool search_fail;  // search string not found
+  int search_len;    // search string length
+  int search_pos;    // position of found string in history (or -1)
+  char search_str[MRL_HIST_SEARCH_LEN + 1]; // search string
+#endif // MRL_USE_HIST_SEARCH
+
 #ifdef MRL_USE_ESC_SEQ
-  char escape_seq;
+  char escape_seq;  // ESC sequence parser state
+  char escape_argn; // number of ESC sequence parameter
+  short escape_arg[2]; // ESC sequence parameters (MRL_ESC_ARGS)
+#endif
+
+#ifdef MRL_USE_PASTE
+  unsigned char paste; // bracketed paste (0-off, 1+matched chars of ESC[201~,
+                       // MRL_PASTE_SKIP - skip other ESC sequence)
+  bool paste_cr;       // last pasted char was CR
 #endif
 
 #if (defined(MRL_ENDL_CRLF) || defined(MRL_ENDL_LFCR))
@@ -44,26 +230,102 @@ typedef struct {
   const char *prompt; // pointer to prompt string
   int prompt_len; // prompt sting length without escape chars
   
+#ifdef MRL_USE_EXT_BUF
+  char *cmdline; // cmdline buffer (caller-owned)
+  int line_len;  // cmdline buffer size
+  char **argv;   // tokens array (caller-owned)
+  int token_num; // max number of tokens
+#else
   char cmdline[MRL_COMMAND_LINE_LEN]; // cmdline buffer
+#endif // MRL_USE_EXT_BUF
   int cmdlen; // last position in command line
   
   int cursor; // input cursor
+  int tpos;   // cursor position on terminal (or -1 if unknown)
+
+#ifdef MRL_USE_SHADOW
+#ifdef MRL_USE_EXT_BUF
+  char *shadow; // copy of command line on terminal (caller-owned)
+#else
+  char shadow[MRL_COMMAND_LINE_LEN]; // copy of command line on terminal
+#endif // MRL_USE_EXT_BUF
+  int slen; // length of command line on terminal
+#endif // MRL_USE_SHADOW
+
+#ifndef MRL_ECHO_OFF
+  bool defer;    // deferred rendering (bulk input)
+  int dirty;     // first changed position in command line (or -1)
+  int dirty_len; // length of command line on terminal before changes
+#endif // !MRL_ECHO_OFF
+
+  // user context (1-st argument of all callbacks)
+  void *ctx;
 
   // ptr to 'print' callback
-  void (*print) (const char *str);
+  void (*print) (void *ctx, const char *str);
+
+#ifdef MRL_USE_OUTBUF
+  char outbuf[MRL_OUTBUF_LEN]; // output staging buffer
+  int outlen; // number of chars in output buffer
+#endif // MRL_USE_OUTBUF
+
+#ifdef MRL_USE_RXQ
+  // RX queue (single producer - interrupt, single consumer - main loop)
+  unsigned char rxq[MRL_RXQ_LEN]; // ring buffer (bytes from UART)
+  volatile mrl_rxq_index_t rxq_head; // free running write index (producer)
+  volatile mrl_rxq_index_t rxq_tail; // free running read index (consumer)
+  volatile unsigned rxq_lost; // number of lost chars (queue overflow)
+  volatile unsigned rxq_max;  // max number of chars in queue (high water)
+#endif // MRL_USE_RXQ
 
   // ptr to 'execute' callback
-  void (*execute) (int argc, char * const argv[]);
+  void (*execute) (void *ctx, int argc, char * const argv[]);
   
 #ifdef MRL_USE_COMPLETE
   // ptr to 'completion' callback (optoinal)
-  const char** (*get_completion) (int argc, char * const argv[]);
+  const char** (*get_completion) (void *ctx, int argc, char * const argv[]);
+
+  // ptr to streaming 'completion' callback (optional)
+  void (*complete) (void *ctx, int argc, char * const argv[],
+                    mrl_compl_t *compl);
 #endif // MRL_USE_COMPLETE
 
+#ifdef MRL_COMPLETE_WIDTH
+  int width; // terminal width for completion variants columns
+#endif // MRL_COMPLETE_WIDTH
+
+#ifdef MRL_USE_COMPL_CACHE
+  // completion cache: line before token, token and variants (with '\0')
+  char cache[MRL_COMPL_CACHE_LEN];
+  int cache_len; // number of used bytes (0 - cache is empty)
+  int cache_key; // length of line before token
+  int cache_tok; // length of token
+#endif // MRL_USE_COMPL_CACHE
+
+#ifdef MRL_USE_COMPL_MENU
+  int menu;     // index of variant in line (-1 - menu completion is off)
+  int menu_tok; // length of typed token (variants are started with it)
+#endif // MRL_USE_COMPL_MENU
+
+#ifdef MRL_USE_CMD
+  const mrl_cmd_t *cmd; // command tree (or NULL)
+  int cmd_num;          // number of records in command tree
+#endif // MRL_USE_CMD
+
 #ifdef MRL_USE_CTRL_C
   // ptr to 'CTRL+C' callback (optional)
-  void (*sigint) (void);
+  void (*sigint) (void *ctx);
 #endif // MRL_USE_CTRL_C
+
+#ifdef MRL_USE_TICK
+  bool rx;            // input received after last mrl_tick() call
+  unsigned rx_time;   // time of last input [ms]
+  unsigned idle_time; // time of last input or 'idle' callback call [ms]
+  unsigned idle_ms;   // 'idle' callback period [ms]
+
+  // ptr to 'idle' callback (optional)
+  void (*idle) (void *ctx);
+#endif // MRL_USE_TICK
 } mrl_t;
 //-----------------------------------------------------------------------------
 #ifdef __cplusplus
@@ -71,8 +333,22 @@ extern "C"
 {
 #endif // __cplusplus
 //-----------------------------------------------------------------------------
+#ifndef MRL_USE_EXT_BUF
 // init internal data, calls once at start up
-void mrl_init(mrl_t *self, void (*print)(const char*));
+// (ctx - user context, passed to all callbacks as 1-st argument)
+void mrl_init(mrl_t *self, void (*print)(void*, const char*), void *ctx);
+#else
+// init internal data with caller-owned buffers, calls once at start up
+// (buffers must live as long as MicroRL object)
+void mrl_init_ext(mrl_t *self, const mrl_mem_t *mem,
+                  void (*print)(void*, const char*), void *ctx);
+#endif // MRL_USE_EXT_BUF
+//-----------------------------------------------------------------------------
+// get user context (set by mrl_init())
+INLINE void *mrl_get_ctx(const mrl_t *self)
+{
+  return self->ctx;
+}
 //-----------------------------------------------------------------------------
 // set prompt string
 INLINE void mrl_set_prompt(mrl_t *self, const char *prompt, int prompt_len)
@@ -91,10 +367,10 @@ void mrl_prompt(mrl_t *self);
 void mrl_refresh(mrl_t *self);
 //-----------------------------------------------------------------------------
 // pointer to callback func, that called when user press 'Enter'
-// execute func param: argc - argument count, argv - pointer array to
-// token string
+// execute func param: ctx - user context, argc - argument count,
+// argv - pointer array to token string
 INLINE void mrl_set_execute_cb(mrl_t *self,
-                               void (*execute)(int, char * const[]))
+                               void (*execute)(void*, int, char * const[]))
 {
   self->execute = execute;
 }
@@ -102,29 +378,217 @@ INLINE void mrl_set_execute_cb(mrl_t *self,
 #ifdef MRL_USE_COMPLETE
 // set pointer to callback complition func, that called when user press 'Tab'
 // callback func description:
-//   param: argc - argument count, argv - pointer array to token string
+//   param: ctx - user context, argc - argument count,
+//          argv - pointer array to token string
 //   must return NULL-terminated string, contain complite variant splitted
 //   by 'Whitespace'. If complite token found, it's must contain only one
 //   token to be complitted Empty string if complite not found, and multiple
 //   string if there are some token
 INLINE void mrl_set_complete_cb(
-        mrl_t *self, const char**(*get_completion)(int, char * const[]))
+        mrl_t *self, const char**(*get_completion)(void*, int, char * const[]))
 {
   self->get_completion = get_completion;
+#ifdef MRL_USE_COMPL_CACHE
+  self->cache_len = 0;
+#endif // MRL_USE_COMPL_CACHE
 }
+//-----------------------------------------------------------------------------
+// set pointer to streaming completion callback, that called when user press
+// 'Tab' (instead of 'completion' callback), it must give each variant of
+// last token by mrl_compl_add(), so number of variants is not limited;
+// if there are some variants, callback is called twice (second time
+// variants are printed), so it must give the same variants
+INLINE void mrl_set_compl_cb(
+        mrl_t *self, void (*complete)(void*, int, char * const[], mrl_compl_t*))
+{
+  self->complete = complete;
+#ifdef MRL_USE_COMPL_CACHE
+  self->cache_len = 0;
+#endif // MRL_USE_COMPL_CACHE
+}
+//-----------------------------------------------------------------------------
+// give one variant of completion (call it in streaming completion callback)
+void mrl_compl_add(mrl_compl_t *compl, const char *str);
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_COMPL_CACHE
+// drop cached completion variants (call it if variants are changed not by
+// command, cache is dropped on ENTER anyway)
+INLINE void mrl_compl_reset(mrl_t *self)
+{
+  self->cache_len = 0;
+}
+#endif // MRL_USE_COMPL_CACHE
+//-----------------------------------------------------------------------------
+#ifdef MRL_COMPLETE_WIDTH
+// set terminal width (number of chars in line) for completion variants,
+// it's limited by MRL_COMPLETE_WIDTH
+INLINE void mrl_set_width(mrl_t *self, int width)
+{
+  self->width = width;
+}
+#endif // MRL_COMPLETE_WIDTH
 #endif // MRL_USE_COMPLETE
 //-----------------------------------------------------------------------------
+#ifdef MRL_USE_CMD
+// set command tree (NULL - off), ENTER calls handler of found command or
+// option with rest of tokens ('execute' callback is called if command is not
+// found or has no handler), TAB completes names of commands and options
+// (if completion callbacks are not set); return false if records are not
+// sorted (command tree is off then)
+bool mrl_set_cmd(mrl_t *self, const mrl_cmd_t *cmd);
+//-----------------------------------------------------------------------------
+// find command/option by tokens (NULL if first token is not command),
+// used - number of tokens which are names of command and options
+const mrl_cmd_t *mrl_cmd_find(const mrl_t *self, int argc,
+                              char * const argv[], int *used);
+//-----------------------------------------------------------------------------
+// get options of command (parent = -1 - root commands), return first
+// record and number of records (num), records are sorted by name
+const mrl_cmd_t *mrl_cmd_children(const mrl_t *self, int parent, int *num);
+//-----------------------------------------------------------------------------
+// find record by ID (linear search, use it for help only)
+const mrl_cmd_t *mrl_cmd_by_id(const mrl_t *self, int id);
+#endif // MRL_USE_CMD
+//-----------------------------------------------------------------------------
 #ifdef MRL_USE_CTRL_C
 // set callback for Ctrl+C terminal signal
-INLINE void mrl_set_sigint_cb(mrl_t *self, void (*sigintf)(void))
+INLINE void mrl_set_sigint_cb(mrl_t *self, void (*sigintf)(void*))
 {
   self->sigint = sigintf;
 }
 #endif // MRL_USE_CTRL_C
 //-----------------------------------------------------------------------------
-// insert char to cmdline (for example call in usart RX interrupt)
+#ifdef MRL_USE_TICK
+// set callback called every 'idle_ms' ms without input (by mrl_tick())
+INLINE void mrl_set_idle_cb(mrl_t *self, unsigned idle_ms,
+                            void (*idle)(void*))
+{
+  self->idle_ms = idle_ms;
+  self->idle    = idle;
+}
+//-----------------------------------------------------------------------------
+// call periodically with current time in milliseconds (any start value),
+// resolve bare ESC and drop half-received ESC sequence after timeout,
+// call 'idle' callback (return 27 (ESC) if bare ESC pressed, else 0)
+int mrl_tick(mrl_t *self, unsigned now);
+#endif // MRL_USE_TICK
+//-----------------------------------------------------------------------------
+// insert char to cmdline (for example call in usart RX interrupt,
+// but better use RX queue, see MRL_USE_RXQ)
 // (return non zero key code if Ctrl+KEY pressed, else 0)
 int mrl_insert_char(mrl_t *self, int ch);
+//-----------------------------------------------------------------------------
+// insert some chars to cmdline (for example after read() or USB packet),
+// command line is rendered once at end of chunk or before callback call
+// (return non zero key code if Ctrl+KEY pressed, else 0);
+// len - number of chars in buffer (in), number of processed chars (out),
+// processing stops after char with non zero key code, call again for rest
+int mrl_insert_chars(mrl_t *self, const char *buf, int *len);
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_RXQ
+// put received char to RX queue (safe to call in RX interrupt),
+// return false if queue is full and char is lost
+INLINE bool mrl_rx_push(mrl_t *self, unsigned char ch)
+{
+  mrl_rxq_index_t head = self->rxq_head;
+  mrl_rxq_index_t used = (mrl_rxq_index_t)
+                         (head - MRL_RXQ_LOAD(&self->rxq_tail));
+
+  if (used >= MRL_RXQ_LEN)
+  { // overflow
+    self->rxq_lost++;
+    return false;
+  }
+
+  self->rxq[head & (MRL_RXQ_LEN - 1)] = ch;
+  MRL_RXQ_STORE(&self->rxq_head, (mrl_rxq_index_t) (head + 1));
+
+  if (++used > self->rxq_max)
+    self->rxq_max = used;
+
+  return true;
+}
+//-----------------------------------------------------------------------------
+// handle all chars received to RX queue (call in main loop),
+// (return non zero key code if Ctrl+KEY pressed, else 0);
+// processing stops after char with non zero key code, call again for rest
+int mrl_process(mrl_t *self);
+#endif // MRL_USE_RXQ
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_PASTE
+// enable/disable bracketed paste mode in terminal (ESC[?2004h / ESC[?2004l),
+// don't forget disable it before exit
+void mrl_set_paste(mrl_t *self, bool enable);
+#endif // MRL_USE_PASTE
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_SNAPSHOT
+// size of history snapshot
+INLINE int mrl_hist_snap_size(const mrl_t *self)
+{
+#ifdef MRL_USE_EXT_BUF
+  return (int) sizeof(mrl_snap_t) + self->hist.len;
+#else
+  return (int) sizeof(mrl_snap_t) + MRL_RING_HISTORY_LEN;
+#endif // MRL_USE_EXT_BUF
+}
+//-----------------------------------------------------------------------------
+// write history snapshot by 'write' callback (return size or -1 on error,
+// 'write' return number of written bytes)
+int mrl_hist_export(mrl_t *self,
+                    int (*write)(void *ctx, const void *buf, int len),
+                    void *ctx);
+//-----------------------------------------------------------------------------
+// check snapshot header and checksum
+bool mrl_hist_snap_check(const void *snap, int size);
+//-----------------------------------------------------------------------------
+// restore history from snapshot (copy, checksum is checked), ring buffers
+// of other size are restored line by line
+bool mrl_hist_import(mrl_t *self, const void *snap, int size);
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_EXT_BUF
+// use writable snapshot memory (like private mmap of file) as history ring
+// buffer without copying and checksum checking (see mrl_hist_snap_check()),
+// memory must live as long as MicroRL object
+bool mrl_hist_adopt(mrl_t *self, void *snap, int size);
+#endif // MRL_USE_EXT_BUF
+//-----------------------------------------------------------------------------
+// save lines from journal ('\0' terminated lines, incomplete last line is
+// skipped) to history (return number of lines)
+int mrl_hist_replay(mrl_t *self, const char *log, int size);
+//-----------------------------------------------------------------------------
+// set callback for journal of history (called for each line saved to history,
+// append line with '\0' to journal and rewrite snapshot sometimes)
+INLINE void mrl_set_journal_cb(mrl_t *self,
+                               void (*journal)(void*, const char*))
+{
+  self->hist.journal = journal;
+  self->hist.ctx     = self->ctx;
+}
+#endif // MRL_USE_HIST_SNAPSHOT
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_SHARED
+// select shared history of MicroRL object (NULL - history is off),
+// history is off after init (ring buffer is owned by caller)
+INLINE void mrl_hist_share(mrl_t *self, mrl_hist_shared_t *shared)
+{
+  self->hist.shared = shared;
+  self->hist.cur    = -1;
+}
+#endif // MRL_USE_HIST_SHARED
+//-----------------------------------------------------------------------------
+// copy tokens (argv of 'execute' callback) to caller buffer, so they may
+// be used after callback return (command line is reused for next input),
+// for example by other thread; dst - array of argc + 1 pointers
+// (NULL terminated); return number of used bytes or -1 if buffer is small
+int mrl_argv_copy(char *buf, int size, char **dst,
+                  int argc, char * const argv[]);
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_OUTBUF
+// send all staged output by one 'print' callback call
+void mrl_flush(mrl_t *self);
+#else
+INLINE void mrl_flush(mrl_t *self) { (void) self; }
+#endif // MRL_USE_OUTBUF
 //----------------------------------------------------------------------------
 #if defined(MRL_UINT2STR) || defined(MRL_INT2STR) || !defined(MRL_USE_LIBC_STDIO)
 // convert unsigned integer value to string (return string length)
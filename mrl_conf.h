@@ -26,6 +26,13 @@
 #  define MRL_COMMAND_TOKEN_NUM 20 // FIXME
 #endif
 //-----------------------------------------------------------------------------
+// Define it, if you wanna give caller-owned buffers (command line, history
+// ring, tokens array) to each MicroRL object by mrl_init_ext(), so buffers
+// size may be different for each object and memory may be taken from pool
+// (MRL_COMMAND_LINE_LEN, MRL_RING_HISTORY_LEN and MRL_COMMAND_TOKEN_NUM
+// are not used by library then).
+//#define MRL_USE_EXT_BUF
+//-----------------------------------------------------------------------------
 // Define you prompt string here. You can use colors escape code,
 // for highlight you prompt (if you terminal supports color).
 // #define MRL_PROMPT_DEFAULT "\033[31m=>\033[0m " - red color
@@ -67,6 +74,43 @@
 #  endif
 #endif
 //-----------------------------------------------------------------------------
+// Define it, if you wanna print completion variants in aligned columns by
+// terminal width (set by mrl_set_width(), it's default and max width), each
+// row of variants is sent by one 'print' call (MRL_COMPLETE_COLS is not
+// used then). Row buffer of MRL_COMPLETE_WIDTH bytes is taken from stack.
+//#define MRL_COMPLETE_WIDTH 80
+//-----------------------------------------------------------------------------
+// Define it, if you wanna keep last completion variants in cache: next TAB
+// after longer last token (more chars typed) filters cached variants
+// without command line split and callback call, list of variants is
+// printed from cache too. Cache is dropped on ENTER, if text before last
+// token is changed and by mrl_compl_reset(). Only variants started with last
+// token are cached (else or if cache is full callback is called again).
+//#define MRL_USE_COMPL_CACHE
+//-----------------------------------------------------------------------------
+// Completion cache size (line before token, token and variants with '\0')
+#ifdef MRL_USE_COMPL_CACHE
+#  ifndef MRL_COMPL_CACHE_LEN
+#    define MRL_COMPL_CACHE_LEN 256 // FIXME
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+// Define it, if you wanna menu completion: if there are some cached variants,
+// TAB replace last token by first variant (list is not printed), next TAB
+// give next variant, Shift+TAB give previous one. Only changed part of token
+// is redrawn and callback is not called again. Any other key stop it.
+//#define MRL_USE_COMPL_MENU
+//-----------------------------------------------------------------------------
+// Define it, if you wanna give const command tree (commands and options with
+// handlers) to library by mrl_set_cmd(). Tree records are sorted by parent ID
+// and name, so ENTER and TAB find each token by binary search (table may be
+// placed in ROM, no RAM index) instead of linear scan of all records in
+// 'execute' and 'completion' callbacks.
+//#define MRL_USE_CMD
+//-----------------------------------------------------------------------------
+// Define it, if records of command tree have 'args' and 'help' strings
+//#define MRL_USE_CMD_HELP
+//-----------------------------------------------------------------------------
 // Define it, if you wanna use history. It s work's like bash history, and
 // set stored value to cmdline, if UP and DOWN key pressed. Using history add
 // memory consuming, depends from MRL_RING_HISTORY_LEN parametr
@@ -83,6 +127,86 @@
 #  endif
 #endif
 //-----------------------------------------------------------------------------
+// Define it, if you wanna keep index of lines start offsets in history ring
+// buffer, so UP/DOWN, deleting of olderest line and jump to first/last line
+// are done without scanning of buffer (useful for big MRL_RING_HISTORY_LEN).
+// Index size is MRL_HIST_INDEX_LEN * sizeof(MRL_HIST_INDEX_TYPE) bytes
+// (printed at compile time), it limits number of lines in history.
+//#define MRL_USE_HIST_INDEX
+//-----------------------------------------------------------------------------
+// Max number of lines in history (must be power of 2) and type of offsets
+// (unsigned type, which can hold MRL_RING_HISTORY_LEN - 1)
+#ifdef MRL_USE_HIST_INDEX
+#  ifndef MRL_HIST_INDEX_LEN
+#    define MRL_HIST_INDEX_LEN 64 // FIXME
+#  endif
+#  ifndef MRL_HIST_INDEX_TYPE
+#    define MRL_HIST_INDEX_TYPE unsigned short // FIXME
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+// Define it, if you wanna keep only one copy of each line in history: saved
+// line deletes earlier identical line (move to front), so ring buffer holds
+// more different commands. Table of lines hashes finds duplicates without
+// scanning of buffer, its size is MRL_HIST_DEDUP_LEN * sizeof(hash) bytes.
+//#define MRL_USE_HIST_DEDUP
+//-----------------------------------------------------------------------------
+// Size of lines hashes table and type of hash. Table size must be power of 2
+// and it limits number of lines in history by MRL_HIST_DEDUP_LEN - 1 (oldest
+// line is deleted if table is full, even if ring buffer has free space), so
+// set it to MRL_RING_HISTORY_LEN / (average line length + 1) or more, but
+// MRL_RING_HISTORY_LEN / 16 at least (checked below without MRL_USE_EXT_BUF,
+// with it - check size of ring buffer given to mrl_init_ext() yourself)
+#ifdef MRL_USE_HIST_DEDUP
+#  ifndef MRL_HIST_DEDUP_LEN
+#    define MRL_HIST_DEDUP_LEN 64 // FIXME
+#  endif
+#  ifndef MRL_HIST_DEDUP_TYPE
+#    define MRL_HIST_DEDUP_TYPE unsigned short // FIXME
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+// Define it, if you wanna front-coded history ring buffer: each line (except
+// newest) is saved as length of prefix shared with next (newer) line plus
+// suffix, so similar commands take few bytes and history holds more lines.
+// Lines are decoded on UP/DOWN only. Can't be used with MRL_USE_HIST_DEDUP
+// and MRL_USE_HIST_SEARCH (they compare raw lines in ring buffer).
+//#define MRL_USE_HIST_FRONT
+//-----------------------------------------------------------------------------
+// Define it, if you wanna one history ring buffer shared by all MicroRL
+// objects (sessions): line saved in one session is seen in others, each
+// object keeps only cursor. Lines are saved by one object at a time (other
+// writers wait in short spin loop, see MRL_SEQ_PAUSE), readers don't lock
+// and check that line was not changed. MRL_RING_HISTORY_LEN must be power of 2,
+// MRL_USE_EXT_BUF history buffer is not used, history is off until
+// mrl_hist_share() is called with caller's mrl_hist_shared_t object.
+//#define MRL_USE_HIST_SHARED
+//-----------------------------------------------------------------------------
+// Define it, if you wanna save history to flash/file and restore it after
+// restart: mrl_hist_export() write snapshot (header + ring buffer image),
+// mrl_hist_import() restore it, mrl_hist_adopt() use snapshot memory as ring
+// buffer without copying (MRL_USE_EXT_BUF), new lines may be appended to
+// journal by callback and restored by mrl_hist_replay().
+//#define MRL_USE_HIST_SNAPSHOT
+//-----------------------------------------------------------------------------
+// Define it, if you wanna UP/DOWN visit only history lines which start with
+// text before cursor (like bash 'history-search-backward'). Prefix is taken
+// on first UP, lines are compared inside ring buffer and only found line is
+// shown. PAGE UP/DOWN still jump to oldest/newest line.
+//#define MRL_USE_HIST_PREFIX
+//-----------------------------------------------------------------------------
+// Define it, if you wanna incremental reverse history search by Ctrl+R
+// (like bash): typed chars narrow substring search, Ctrl+R - older match,
+// Ctrl+G - cancel, other keys accept found line.
+//#define MRL_USE_HIST_SEARCH
+//-----------------------------------------------------------------------------
+// Max length of search string (MRL_USE_HIST_SEARCH)
+#ifdef MRL_USE_HIST_SEARCH
+#  ifndef MRL_HIST_SEARCH_LEN
+#    define MRL_HIST_SEARCH_LEN 32 // FIXME
+#  endif
+#endif
+//-----------------------------------------------------------------------------
 // Enable Handling terminal ESC sequence. If disabling, then cursor arrow,
 // HOME, END, DELETE will not work (use Ctrl+A(B,F,P,N,A,E,H,K,U,C,D)) but
 // decrease code memory.
@@ -91,6 +215,91 @@
 // Disable out ESC sequence 
 //#define MRL_PRINT_ESC_OFF // FIXME
 //-----------------------------------------------------------------------------
+// Define it, if you wanna gather all output produced while one input char is
+// handled into buffer and send it by one 'print' callback call (one UART
+// driver transaction or one write() syscall instead of some).
+//#define MRL_USE_OUTBUF // FIXME
+//-----------------------------------------------------------------------------
+// Output buffer length (if longer output - buffer flush some times)
+#ifdef MRL_USE_OUTBUF
+#  ifndef MRL_OUTBUF_LEN
+#    define MRL_OUTBUF_LEN 64 // FIXME
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+// Define it, if you wanna batch output across several input chars, then
+// mrl_insert_char() don't flush output buffer and you must call mrl_flush()
+// yourself (output is flushed anyway before any user callback call).
+//#define MRL_OUTBUF_MANUAL_FLUSH
+//-----------------------------------------------------------------------------
+// Define it, if you wanna keep shadow copy of command line shown in terminal
+// and send only changed chars after each edit (cursor moves, changed chars
+// and erase to end of line). It decrease output on slow links with long
+// lines and history recall, but add MRL_COMMAND_LINE_LEN bytes of memory.
+//#define MRL_USE_SHADOW // FIXME
+//-----------------------------------------------------------------------------
+// Enable CHA (ESC[nG - cursor horizontal absolute) for cursor positioning,
+// if you terminal supports it (it's not VT100 sequence, but ECMA-48).
+// Cursor is always set by the shortest way (counting bytes) from CR+ESC[nC,
+// ESC[nG, ESC[nD, ESC[nC, backspaces or reprint chars of command line.
+//#define MRL_USE_CHA
+//-----------------------------------------------------------------------------
+// Define it, if you wanna put received chars to RX queue in interrupt by
+// mrl_rx_push() and handle them in main loop by mrl_process(), so redraw
+// and user callbacks are never run in interrupt context.
+//#define MRL_USE_RXQ
+//-----------------------------------------------------------------------------
+// RX queue length (must be power of 2) and type of RX queue indexes
+// (unsigned type which is read and written atomically by CPU, for 8-bit MCU
+// use 'unsigned char' and MRL_RXQ_LEN <= 128)
+#ifdef MRL_USE_RXQ
+#  ifndef MRL_RXQ_LEN
+#    define MRL_RXQ_LEN 64 // FIXME
+#  endif
+#  ifndef MRL_RXQ_INDEX
+#    define MRL_RXQ_INDEX unsigned // FIXME
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+// Define it, if you call mrl_tick() periodically (for example every 10 ms)
+// with current time in milliseconds: bare ESC is resolved (mrl_tick()
+// return MRL_KEY_ESC) and half-received ESC sequence is dropped after
+// MRL_ESC_TIMEOUT ms without input, bracketed paste is ended (lost end of
+// paste) after MRL_PASTE_TIMEOUT ms without input, 'idle' callback is called
+// every 'idle_ms' ms without input (auto logout, prompt refresh and so on).
+//#define MRL_USE_TICK
+//-----------------------------------------------------------------------------
+// ESC sequence timeout [ms]
+#ifdef MRL_USE_TICK
+#  ifndef MRL_ESC_TIMEOUT
+#    define MRL_ESC_TIMEOUT 100 // FIXME
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+// Enable xterm bracketed paste mode (call mrl_set_paste() to switch it on in
+// terminal by ESC[?2004h). Text between ESC[200~ and ESC[201~ is inserted to
+// command line as is (TAB, arrows and other keys don't work inside) and
+// command line is redrawn once at end of paste.
+//#define MRL_USE_PASTE
+//-----------------------------------------------------------------------------
+// What to do with new line (CR, LF or CR+LF) inside pasted text:
+//   MRL_PASTE_NL_DROP  - drop it (join lines)
+//   MRL_PASTE_NL_SPACE - replace by space (join lines by space)
+//   MRL_PASTE_NL_EXEC  - execute each pasted line (as Enter pressed)
+#ifdef MRL_USE_PASTE
+#  if !defined(MRL_PASTE_NL_DROP) && !defined(MRL_PASTE_NL_EXEC)
+#    define MRL_PASTE_NL_SPACE // FIXME
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+// Bracketed paste timeout [ms]: pasted text may have pauses on slow links
+// (pty, TCP), so it's much longer than MRL_ESC_TIMEOUT
+#if defined(MRL_USE_TICK) && defined(MRL_USE_PASTE)
+#  ifndef MRL_PASTE_TIMEOUT
+#    define MRL_PASTE_TIMEOUT 5000 // FIXME
+#  endif
+#endif
+//-----------------------------------------------------------------------------
 // Use snprintf() from standard compiler library, but it gives some overhead.
 // If not defined, use u16int_to_str() function, it's decrease size of code.
 // Try to build with and without, and compare total code size for tune library.
@@ -139,6 +348,121 @@
 #  endif
 #endif
 //-----------------------------------------------------------------------------
+#ifdef MRL_USE_OUTBUF
+#  if MRL_OUTBUF_LEN < 16
+#    error "MRL_OUTBUF_LEN < 16"
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+#if defined(MRL_USE_SHADOW) && defined(MRL_ECHO_OFF)
+#  error "MRL_USE_SHADOW can't be used with MRL_ECHO_OFF"
+#endif
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_RXQ
+#  if (MRL_RXQ_LEN & (MRL_RXQ_LEN - 1)) != 0 || MRL_RXQ_LEN < 2
+#    error "MRL_RXQ_LEN must be power of 2"
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_PASTE
+#  ifndef MRL_USE_ESC_SEQ
+#    error "MRL_USE_PASTE require MRL_USE_ESC_SEQ"
+#  endif
+#  ifdef MRL_ECHO_OFF
+#    error "MRL_USE_PASTE can't be used with MRL_ECHO_OFF"
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+#if defined(MRL_USE_COMPL_CACHE) && !defined(MRL_USE_COMPLETE)
+#  error "MRL_USE_COMPL_CACHE require MRL_USE_COMPLETE"
+#endif
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_COMPL_MENU
+#  ifndef MRL_USE_COMPL_CACHE
+#    error "MRL_USE_COMPL_MENU require MRL_USE_COMPL_CACHE"
+#  endif
+#  ifdef MRL_ECHO_OFF
+#    error "MRL_USE_COMPL_MENU can't be used with MRL_ECHO_OFF"
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+#ifdef MRL_COMPLETE_WIDTH
+#  ifndef MRL_USE_COMPLETE
+#    error "MRL_COMPLETE_WIDTH require MRL_USE_COMPLETE"
+#  endif
+#  if MRL_COMPLETE_WIDTH < 8
+#    error "MRL_COMPLETE_WIDTH < 8"
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+#if defined(MRL_USE_CMD_HELP) && !defined(MRL_USE_CMD)
+#  error "MRL_USE_CMD_HELP require MRL_USE_CMD"
+#endif
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_INDEX
+#  ifndef MRL_USE_HISTORY
+#    error "MRL_USE_HIST_INDEX require MRL_USE_HISTORY"
+#  endif
+#  if (MRL_HIST_INDEX_LEN & (MRL_HIST_INDEX_LEN - 1)) != 0 || \
+      MRL_HIST_INDEX_LEN < 2
+#    error "MRL_HIST_INDEX_LEN must be power of 2"
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_DEDUP
+#  ifndef MRL_USE_HISTORY
+#    error "MRL_USE_HIST_DEDUP require MRL_USE_HISTORY"
+#  endif
+#  if (MRL_HIST_DEDUP_LEN & (MRL_HIST_DEDUP_LEN - 1)) != 0 || \
+      MRL_HIST_DEDUP_LEN < 4
+#    error "MRL_HIST_DEDUP_LEN must be power of 2 (4 or more)"
+#  endif
+#  if !defined(MRL_USE_EXT_BUF) && \
+      MRL_HIST_DEDUP_LEN * 16 < MRL_RING_HISTORY_LEN
+#    error "MRL_HIST_DEDUP_LEN is too small for MRL_RING_HISTORY_LEN (history is limited by MRL_HIST_DEDUP_LEN - 1 lines)"
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_FRONT
+#  ifndef MRL_USE_HISTORY
+#    error "MRL_USE_HIST_FRONT require MRL_USE_HISTORY"
+#  endif
+#  if defined(MRL_USE_HIST_DEDUP) || defined(MRL_USE_HIST_SEARCH)
+#    error "MRL_USE_HIST_FRONT can't be used with MRL_USE_HIST_DEDUP/MRL_USE_HIST_SEARCH"
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_SHARED
+#  ifndef MRL_USE_HISTORY
+#    error "MRL_USE_HIST_SHARED require MRL_USE_HISTORY"
+#  endif
+#  if (MRL_RING_HISTORY_LEN & (MRL_RING_HISTORY_LEN - 1)) != 0
+#    error "MRL_RING_HISTORY_LEN must be power of 2 (MRL_USE_HIST_SHARED)"
+#  endif
+#  if defined(MRL_USE_HIST_INDEX) || defined(MRL_USE_HIST_DEDUP) || \
+      defined(MRL_USE_HIST_FRONT) || defined(MRL_USE_HIST_SEARCH) || \
+      defined(MRL_USE_HIST_SNAPSHOT)
+#    error "MRL_USE_HIST_SHARED can't be used with other MRL_USE_HIST_* (except PREFIX)"
+#  endif
+#endif
+//-----------------------------------------------------------------------------
+#if defined(MRL_USE_HIST_SNAPSHOT) && !defined(MRL_USE_HISTORY)
+#  error "MRL_USE_HIST_SNAPSHOT require MRL_USE_HISTORY"
+#endif
+//-----------------------------------------------------------------------------
+#if defined(MRL_USE_HIST_PREFIX) && !defined(MRL_USE_HISTORY)
+#  error "MRL_USE_HIST_PREFIX require MRL_USE_HISTORY"
+#endif
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_SEARCH
+#  ifndef MRL_USE_HISTORY
+#    error "MRL_USE_HIST_SEARCH require MRL_USE_HISTORY"
+#  endif
+#  if defined(MRL_ECHO_OFF) || defined(MRL_PRINT_ESC_OFF)
+#    error "MRL_USE_HIST_SEARCH can't be used with MRL_ECHO_OFF/MRL_PRINT_ESC_OFF"
+#  endif
+#endif
+//-----------------------------------------------------------------------------
 #endif // MRL_CONF_H
 
 /*** end of "mrl_conf.h" file ***/
@@ -47,15 +47,103 @@
 // direction of history navigation
 #define MRL_HIST_BACKWARD 0
 #define MRL_HIST_FORWARD  1
+#define MRL_HIST_FIRST    2 // oldest line
+#define MRL_HIST_LAST     3 // newest line (or edited line)
 //-----------------------------------------------------------------------------
-// ESC seq internal codes
-#define MRL_ESC_STOP    0
-#define MRL_ESC_START   1
-#define MRL_ESC_BRACKET 2
-#define MRL_ESC_O       3
-#define MRL_ESC_HOME    4
-#define MRL_ESC_END     5
-#define MRL_ESC_DELETE  6
+// ESC seq parser states
+#define MRL_ESC_STOP   0 // no ESC sequence
+#define MRL_ESC_START  1 // ESC
+#define MRL_ESC_CSI    2 // ESC [ and parameters
+#define MRL_ESC_SS3    3 // ESC O and parameters
+#define MRL_ESC_INTER  4 // intermediate chars (after parameters)
+#define MRL_ESC_IGNORE 5 // swallow unknown sequence up to final char
+#define MRL_ESC_STATES 6
+//-----------------------------------------------------------------------------
+// ESC seq char classes
+#define MRL_ESC_C_DIGIT 0 // '0'...'9'
+#define MRL_ESC_C_SEMI  1 // ';' or ':' - parameters separator
+#define MRL_ESC_C_PRIV  2 // '<', '=', '>', '?' - private parameters
+#define MRL_ESC_C_INTER 3 // ' '...'/' - intermediate chars
+#define MRL_ESC_C_LBR   4 // '['
+#define MRL_ESC_C_SS3   5 // 'O'
+#define MRL_ESC_C_FINAL 6 // other '@'...'~' - final char
+#define MRL_ESC_C_DEL   7 // DEL
+#define MRL_ESC_C_CTRL  8 // control chars (abort sequence)
+#define MRL_ESC_CLASSES 9
+//-----------------------------------------------------------------------------
+// ESC seq parser actions
+#define MRL_ESC_A_NONE  0 // only change state
+#define MRL_ESC_A_CLEAR 1 // clear parameters
+#define MRL_ESC_A_PARAM 2 // add digit to parameter
+#define MRL_ESC_A_NEXT  3 // next parameter
+#define MRL_ESC_A_FINAL 4 // sequence done by final char, run key
+#define MRL_ESC_A_ALT   5 // ESC + char (Alt+char), run key
+#define MRL_ESC_A_ABORT 6 // abort sequence, handle char as usual key
+//-----------------------------------------------------------------------------
+// ESC seq parameters
+#define MRL_ESC_ARGS    2   // number of stored parameters (see mrl_t)
+#define MRL_ESC_ARG_MAX 999 // limit of parameter value
+//-----------------------------------------------------------------------------
+// keys decoded from ESC sequences
+#define MRL_ESC_KEY_NONE        0
+#define MRL_ESC_KEY_UP          1
+#define MRL_ESC_KEY_DOWN        2
+#define MRL_ESC_KEY_RIGHT       3
+#define MRL_ESC_KEY_LEFT        4
+#define MRL_ESC_KEY_HOME        5
+#define MRL_ESC_KEY_END         6
+#define MRL_ESC_KEY_DELETE      7
+#define MRL_ESC_KEY_PGUP        8
+#define MRL_ESC_KEY_PGDN        9
+#define MRL_ESC_KEY_WORD_RIGHT 10 // Ctrl+RIGHT, Alt+RIGHT, Alt+F
+#define MRL_ESC_KEY_WORD_LEFT  11 // Ctrl+LEFT, Alt+LEFT, Alt+B
+#define MRL_ESC_KEY_BACKTAB    12 // Shift+TAB
+#define MRL_ESC_KEY_ALT_BS     13 // Alt+BACKSPACE
+#define MRL_ESC_KEY_PASTE      14 // bracketed paste begin
+//-----------------------------------------------------------------------------
+// xterm modifier parameter (ESC[1;mC): 1 + Shift(1) + Alt(2) + Ctrl(4)
+#define MRL_ESC_MOD_ALT  3
+#define MRL_ESC_MOD_CTRL 5
+//-----------------------------------------------------------------------------
+// bracketed paste state: other ESC sequence is swallowed up to final char
+#define MRL_PASTE_SKIP 0xFF
+#define MRL_IS_ESC_FINAL(chr) ((chr) >= 0x40 && (chr) <= 0x7E) // '@'..'~'
+//-----------------------------------------------------------------------------
+// terminal cursor position is unknown (after user output)
+#define MRL_TPOS_UNKNOWN -1
+//-----------------------------------------------------------------------------
+// cursor move ways
+#define MRL_MOVE_ABS     0 // CR + ESC[nC (or CR + reprint prompt and line)
+#define MRL_MOVE_CHA     1 // ESC[nG
+#define MRL_MOVE_CUB     2 // ESC[nD
+#define MRL_MOVE_CUF     3 // ESC[nC
+#define MRL_MOVE_BS      4 // '\b' x N
+#define MRL_MOVE_REWRITE 5 // reprint known chars of command line
+//-----------------------------------------------------------------------------
+// max unchanged chars reprinted by shadow render instead of cursor move
+#define MRL_SHADOW_GAP 3
+//-----------------------------------------------------------------------------
+// buffers size (fixed or set by mrl_init_ext()) and shadow buffer is set
+#ifdef MRL_USE_EXT_BUF
+#  define MRL_LINE_LEN(mrl)  ((mrl)->line_len)
+#  define MRL_HIST_LEN(hist) ((hist)->len)
+#  define MRL_TOKEN_NUM(mrl) ((mrl)->token_num)
+#  define MRL_SHADOW_ON(mrl) ((mrl)->shadow != NULL) // NULL - full redraw
+#else
+#  define MRL_LINE_LEN(mrl)  MRL_COMMAND_LINE_LEN
+#  define MRL_HIST_LEN(hist) MRL_RING_HISTORY_LEN
+#  define MRL_TOKEN_NUM(mrl) MRL_COMMAND_TOKEN_NUM
+#  define MRL_SHADOW_ON(mrl) 1
+#endif // MRL_USE_EXT_BUF
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_INDEX
+// begin index of history line number n (0 - oldest)
+#define MRL_HIST_IDX(hist, n) \
+  ((hist)->idx[((hist)->first + (n)) & (MRL_HIST_INDEX_LEN - 1)])
+
+// history index size [bytes]
+#define MRL_HIST_INDEX_SIZE (MRL_HIST_INDEX_LEN * sizeof(MRL_HIST_INDEX_TYPE))
+#endif // MRL_USE_HIST_INDEX
 //-----------------------------------------------------------------------------
 #endif // MRL_DEFS_H
 
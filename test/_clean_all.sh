@@ -1,6 +1,6 @@
 #!/bin/sh
 
-for i in 1 2 3
+for i in 1 2 3 4 5 6 7 8 9
 do
   D="test$i"
   if [ -d "$D" ]
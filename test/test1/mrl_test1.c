@@ -11,6 +11,10 @@
 #include <unistd.h> 
 #include <stdio.h>
 #include <stdlib.h>
+#ifdef MRL_USE_HIST_SNAPSHOT
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif // MRL_USE_HIST_SNAPSHOT
 #include "mrl.h"
 //-----------------------------------------------------------------------------
 #define MRL_LIB_VER "1.5.1f" // delivered from "1.5.1" ('f' - forked)
@@ -79,12 +83,17 @@ static char get_char()
 
   return ch;
 }
-// print callback for MicroRL library
 static void print(const char *str)
 {
   fprintf(stdout, "%s", str);
 }
 //-----------------------------------------------------------------------------
+// print callback for MicroRL library
+static void print_cb(void *ctx, const char *str)
+{
+  print(str);
+}
+//-----------------------------------------------------------------------------
 static void print_help()
 {
   print("Use TAB key for completion\n\r"
@@ -105,7 +114,7 @@ static void print_help()
 //-----------------------------------------------------------------------------
 // execute callback for microrl library
 // do what you want here, but don't write to argv!!! read only!!
-static void execute(int argc, char * const argv[])
+static void execute(void *ctx, int argc, char * const argv[])
 {
   int i;
 #ifdef MRL_DEBUG
@@ -205,7 +214,7 @@ static void execute(int argc, char * const argv[])
       else
         strcpy(prompt, "");
 
-      mrl_set_prompt(&mrl, prompt, strlen(prompt));
+      mrl_set_prompt((mrl_t*) ctx, prompt, strlen(prompt));
     }
     else if (strcmp(argv[i], _CMD_PROFIT) == 0)
     {
@@ -222,7 +231,7 @@ static void execute(int argc, char * const argv[])
 //-----------------------------------------------------------------------------
 #ifdef MRL_USE_COMPLETE
 // completion callback for microrl library
-static const char** complete(int argc, char * const argv[])
+static const char** complete(void *ctx, int argc, char * const argv[])
 {
   int i, count = 0;
 
@@ -270,12 +279,108 @@ static const char** complete(int argc, char * const argv[])
 #endif // MRL_USE_COMPLETE
 //-----------------------------------------------------------------------------
 #ifdef MRL_USE_CTRL_C
-static void sigint()
+static void sigint(void *ctx)
 {
   print ("CTRL-C catched!\r\n");
 }
 #endif // MRL_USE_CTRL_C
 
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_SNAPSHOT
+// history snapshot and journal files (in current directory)
+#define HIST_SNAP_FILE "mrl_test1.hist"
+#define HIST_LOG_FILE  "mrl_test1.hlog"
+
+static FILE *hist_log = NULL;
+//-----------------------------------------------------------------------------
+// 'journal' callback: append line saved to history to journal file
+static void hist_journal(void *ctx, const char *str)
+{
+  if (hist_log == NULL) return;
+  fwrite(str, strlen(str) + 1, 1, hist_log);
+  fflush(hist_log);
+}
+//-----------------------------------------------------------------------------
+// 'write' callback of mrl_hist_export()
+static int hist_write(void *ctx, const void *buf, int len)
+{
+  return fwrite(buf, 1, len, (FILE*) ctx);
+}
+//-----------------------------------------------------------------------------
+// map file to memory (private writable copy), return NULL on error
+static void *hist_map(const char *file, int *size)
+{
+  struct stat st;
+  void *ptr;
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) return NULL;
+
+  if (fstat(fd, &st) < 0 || st.st_size == 0)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  ptr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) return NULL;
+
+  *size = st.st_size;
+  return ptr;
+}
+//-----------------------------------------------------------------------------
+// restore history: mapped snapshot is used as ring buffer without parsing
+// (MRL_USE_EXT_BUF) or copied, then lines from journal are added
+static void hist_load()
+{
+  int size;
+  char *ptr = (char*) hist_map(HIST_SNAP_FILE, &size);
+  if (ptr != NULL)
+  {
+    bool adopted = false;
+#ifdef MRL_USE_EXT_BUF
+    adopted = mrl_hist_adopt(&mrl, ptr, size); // mapping is ring buffer now
+#endif // MRL_USE_EXT_BUF
+    if (!adopted)
+    {
+      mrl_hist_import(&mrl, ptr, size);
+      munmap(ptr, size);
+    }
+  }
+
+  ptr = (char*) hist_map(HIST_LOG_FILE, &size);
+  if (ptr != NULL)
+  {
+    mrl_hist_replay(&mrl, ptr, size);
+    munmap(ptr, size);
+  }
+
+  hist_log = fopen(HIST_LOG_FILE, "ab");
+  mrl_set_journal_cb(&mrl, hist_journal);
+}
+//-----------------------------------------------------------------------------
+// write new snapshot (atomic by rename) and clear journal
+static void hist_save()
+{
+  FILE *f = fopen(HIST_SNAP_FILE ".tmp", "wb");
+  if (f == NULL) return;
+
+  if (mrl_hist_export(&mrl, hist_write, f) < 0)
+  {
+    fclose(f);
+    remove(HIST_SNAP_FILE ".tmp");
+    return;
+  }
+  fclose(f);
+
+  if (rename(HIST_SNAP_FILE ".tmp", HIST_SNAP_FILE) == 0)
+  {
+    if (hist_log != NULL) fclose(hist_log);
+    hist_log = NULL;
+    remove(HIST_LOG_FILE);
+  }
+}
+#endif // MRL_USE_HIST_SNAPSHOT
 //-----------------------------------------------------------------------------
 const char *custom_prompt = "\033[35m->\033[0m ";
 const int custom_prompt_len = 3;
@@ -283,7 +388,21 @@ const int custom_prompt_len = 3;
 int main(int argc, char **argv)
 {
   // call init with ptr to microrl instance and print callback
-  mrl_init(&mrl, print);
+#ifdef MRL_USE_EXT_BUF
+  static char line[MRL_COMMAND_LINE_LEN], shadow[MRL_COMMAND_LINE_LEN];
+  static char hist[MRL_RING_HISTORY_LEN];
+  static char *tokens[MRL_COMMAND_TOKEN_NUM + 2];
+  mrl_mem_t mem = { line, sizeof(line), shadow, hist, sizeof(hist),
+                    tokens, MRL_COMMAND_TOKEN_NUM };
+  mrl_init_ext(&mrl, &mem, print_cb, &mrl); // context is MicroRL object
+#else
+  mrl_init(&mrl, print_cb, &mrl); // context is MicroRL object
+#endif // MRL_USE_EXT_BUF
+
+#ifdef MRL_USE_HIST_SNAPSHOT
+  // restore history saved by previous run
+  hist_load();
+#endif // MRL_USE_HIST_SNAPSHOT
 
   // set custom prompt
   mrl_set_prompt(&mrl, custom_prompt, custom_prompt_len);
@@ -305,6 +424,11 @@ int main(int argc, char **argv)
   mrl_set_sigint_cb(&mrl, sigint);
 #endif // MRL_USE_CTRL_C
 
+#ifdef MRL_USE_PASTE
+  // enable bracketed paste mode in terminal
+  mrl_set_paste(&mrl, true);
+#endif // MRL_USE_PASTE
+
   while (1)
   { // put received char from stdin to microrl lib
     int ch = get_char();
@@ -317,6 +441,16 @@ int main(int argc, char **argv)
     }
   }
 
+#ifdef MRL_USE_PASTE
+  // restore terminal mode
+  mrl_set_paste(&mrl, false);
+#endif // MRL_USE_PASTE
+
+#ifdef MRL_USE_HIST_SNAPSHOT
+  // save history for next run
+  hist_save();
+#endif // MRL_USE_HIST_SNAPSHOT
+
   return 0;
 }
 //-----------------------------------------------------------------------------
@@ -36,11 +36,6 @@ struct {
   int size;
 } flash = {63, 2048};
 
-#ifdef MRL_USE_COMPLETE
-// array for comletion
-#define COMPL_NUM 10 // FIXME: magic 
-static const char *compl_world[COMPL_NUM + 1];
-#endif // MRL_USE_COMPLETE
 //-----------------------------------------------------------------------------
 extern cmd_t const cmd_tree[];
 //-----------------------------------------------------------------------------
@@ -138,7 +133,7 @@ cmd_t const cmd_tree[] = {
 //-----------------------------------------------------------------------------
 // execute callback for microrl library
 // do what you want here, but don't write to argv!!! read only!!
-static void execute(int argc, char * const argv[])
+static void execute(void *ctx, int argc, char * const argv[])
 {
   int i, parent = -1, arg_shift;
   const cmd_t *found = (cmd_t*) NULL;
@@ -174,10 +169,12 @@ static void execute(int argc, char * const argv[])
 }
 //-----------------------------------------------------------------------------
 #ifdef MRL_USE_COMPLETE
-// completion callback for microrl library
-static const char** complete(int argc, char * const argv[])
+// streaming completion callback for microrl library
+// (variants are given one by one, so their number is not limited)
+static void complete(void *ctx, int argc, char * const argv[],
+                     mrl_compl_t *compl)
 {
-  int i, parent = -1, count = 0;
+  int i, parent = -1;
 
 #ifdef MRL_DEBUG
   mrl_clear(&mrl);
@@ -188,22 +185,6 @@ static const char** complete(int argc, char * const argv[])
   mrl_refresh(&mrl);
 #endif
 
-#if 0
-  if (argc == 0)
-  { // if there is no any token in cmdline, just print all available commands
-    const cmd_t *cmd = cmd_tree;
-    while (cmd->name != NULL)
-    {
-      if (count < COMPL_NUM && cmd->parent < 0)
-        compl_world[count++] = cmd->name;
-      cmd++;
-    }
-  
-    compl_world[count] = NULL;
-    return compl_world;
-  }
-#endif
-
   for (i = 0; i < argc ; i++)
   {
     const cmd_t *cmd = cmd_tree;
@@ -213,8 +194,8 @@ static const char** complete(int argc, char * const argv[])
 	  (parent != -1 || i == 0))
       { // substring found => add it to completion set
 
-        if (i == argc - 1 && count < COMPL_NUM)
-	  compl_world[count++] = cmd->name;
+        if (i == argc - 1)
+	  mrl_compl_add(compl, cmd->name);
 
         if (strcmp(cmd->name, argv[i]) == 0)
 	{ // command/option full found
@@ -226,14 +207,11 @@ static const char** complete(int argc, char * const argv[])
       cmd++;
     } // while
   } // for
-
-  compl_world[count] = NULL;
-  return compl_world;
 }
 #endif // MRL_USE_COMPLETE
 //-----------------------------------------------------------------------------
 // print callback for MicroRL library
-static void print(const char *str)
+static void print(void *ctx, const char *str)
 {
   fprintf(stdout, "%s", str);
 }
@@ -268,7 +246,7 @@ const int   prompt_len = 9;
 int main(int argc, char **argv)
 {
   // call init with ptr to microrl instance and print callback
-  mrl_init(&mrl, print);
+  mrl_init(&mrl, print, NULL); // no context
 
   // set custom prompt
   mrl_set_prompt(&mrl, prompt, prompt_len);
@@ -282,7 +260,7 @@ int main(int argc, char **argv)
 
 #ifdef MRL_USE_COMPLETE
   // set callback for completion
-  mrl_set_complete_cb(&mrl, complete);
+  mrl_set_compl_cb(&mrl, complete);
 #endif // MRL_USE_COMPLETE
 
   while (1)
@@ -13,22 +13,7 @@
 #include <stdlib.h>
 #include "mrl.h"
 //-----------------------------------------------------------------------------
-#define CLI_HELP
-#define MAX_CMD   80 // maximum number of tokens
-#define COMPL_NUM 10 // maximum completion tokens
-//-----------------------------------------------------------------------------
-// command/options description structure
-typedef struct cmd_ cmd_t;
-struct cmd_ {
-  int16_t id;        // ID in tree (>=0)
-  int16_t parent_id; // parent ID for options (or -1 for root)
-  void (*fn)(int argc, char* const argv[], const cmd_t*); // callback function
-  const char *name;  // command/option name
-#ifdef CLI_HELP
-  const char *args;  // arguments for help
-  const char *help;  // help (description) string 
-#endif // CLI_HELP
-};
+#define MAX_DEPTH 8 // maximum depth of command tree
 //-----------------------------------------------------------------------------
 // MicroRL object
 static mrl_t mrl;
@@ -41,276 +26,159 @@ struct {
   int page;
   int size;
 } flash = {63, 2048};
-
-#ifdef MRL_USE_COMPLETE
-// array for comletion
-static const char *compl_world[COMPL_NUM + 1];
-#endif // MRL_USE_COMPLETE
 //-----------------------------------------------------------------------------
-extern cmd_t const cmd_tree[];
+// print command/option with all parents and help
+static void help_line(const mrl_cmd_t *cmd)
+{
+#ifdef MRL_USE_CMD_HELP
+  int parents_cnt = 0;
+  const mrl_cmd_t *parents[MAX_DEPTH];
+  const mrl_cmd_t *p = cmd;
+
+  // find all parents
+  while (p->parent >= 0 && parents_cnt < MAX_DEPTH)
+    p = parents[parents_cnt++] = mrl_cmd_by_id(&mrl, p->parent);
+
+  // print all parents
+  printf(" ");
+  while (--parents_cnt >= 0)
+    printf("%s ", parents[parents_cnt]->name);
+
+  // print command and help
+  printf("%s\033[33m%s\033[0m - \033[32m%s\033[0m\r\n",
+         cmd->name, cmd->args, cmd->help);
+#endif // MRL_USE_CMD_HELP
+}
 //-----------------------------------------------------------------------------
-#ifdef CLI_HELP
-// find command record by ID
-static const cmd_t *cmd_by_id(int id)
+// print help of all options of command (depth first)
+static void help_tree(int parent)
 {
-  const cmd_t *o;
-  for (o = cmd_tree; o->name != NULL; o++)
-    if (o->id == id)
-      break;
-  return o;
+  int i, num;
+  const mrl_cmd_t *cmd = mrl_cmd_children(&mrl, parent, &num);
+
+  for (i = 0; i < num; i++)
+  {
+    help_line(cmd + i);
+    help_tree(cmd[i].id);
+  }
 }
-#endif // CLI_HELP
 //-----------------------------------------------------------------------------
 // show help based on command/option tree
-void fn_help(int argc, char* const argv[], const cmd_t *cmd)
-{ // help
-#ifdef CLI_HELP
-  if (cmd->id == 0)
+static void fn_help(void *ctx, int argc, char * const argv[],
+                    const mrl_cmd_t *cmd)
+{
+  if (strcmp(cmd->name, "help") == 0)
   { // root (full) help
-    const cmd_t *o;
-
     printf("MicroRL test #3\r\n"
            "Use TAB key for completion\r\n"
            "Command:\r\n");
-
-    for (o = cmd_tree; o->name != NULL; o++)
-    {
-      int i, parents_cnt = 0;
-      const cmd_t *parents[MAX_CMD];
-      const cmd_t *p = o;
-
-      // find all parents
-      for (i = 0; i < MAX_CMD; i++)
-        if (p->parent_id >= 0)
-          p = parents[parents_cnt++] = cmd_by_id((int) p->parent_id);
-        else
-          break;
-
-      // print all parents
-      printf(" ");
-      while (--parents_cnt >= 0)
-        printf("%s ", parents[parents_cnt]->name);
-
-      // print command and help
-      printf("%s\033[33m%s\033[0m - \033[32m%s\033[0m\r\n",
-             o->name, o->args, o->help);
-    } // for (o
+    help_tree(-1);
   }
   else
   { // command (partial) help
-    const cmd_t *o;
-
-    // print command help header
+#ifdef MRL_USE_CMD_HELP
     printf("%s:\r\n", cmd->help);
-
-    // find all parent/children
-    for (o = cmd_tree; o->name != NULL; o++)
-    {
-      int i, flg = 0, parents_cnt = 0;
-      const cmd_t *parents[MAX_CMD];
-      const cmd_t *p = o;
-
-      // find all parents
-      for (i = 0; i < MAX_CMD; i++)
-      {
-        if (p->parent_id >= 0)
-        {
-          if (p->parent_id == cmd->id)
-            flg = 1;
-          p = parents[parents_cnt++] = cmd_by_id((int) p->parent_id);
-        }
-        else
-          break;
-      }
-
-      if (flg)
-      {
-        // print all parents
-        printf(" ");
-        while (--parents_cnt >= 0)
-          printf("%s ", parents[parents_cnt]->name);
-
-        // print command and help
-        printf("%s\033[33m%s\033[0m - \033[32m%s\033[0m\r\n",
-               o->name, o->args, o->help);
-      }
-    } // for
+#endif // MRL_USE_CMD_HELP
+    help_tree(cmd->id);
   }
-#endif // CLI_HELP
 }
 //-----------------------------------------------------------------------------
-void fn_ver_mrl(int argc, char* const argv[], const cmd_t *cmd)
+static void fn_ver_mrl(void *ctx, int argc, char * const argv[],
+                       const mrl_cmd_t *cmd)
 {
   printf("MicroRL version 2.2 (forked) argc=%i\r\n", argc);
 }
 //-----------------------------------------------------------------------------
-void fn_ver_demo(int argc, char* const argv[], const cmd_t *cmd)
+static void fn_ver_demo(void *ctx, int argc, char * const argv[],
+                        const mrl_cmd_t *cmd)
 {
   printf("MicroRL demo test version 3.0 argc=%i\r\n", argc);
 }
 //-----------------------------------------------------------------------------
-void fn_clear(int argc, char* const argv[], const cmd_t *cmd)
+static void fn_clear(void *ctx, int argc, char * const argv[],
+                     const mrl_cmd_t *cmd)
 {
   printf("\033[2J"); // ESC seq for clear entire screen
   printf("\033[H");  // ESC seq for move cursor at left-top corner
 }
 //-----------------------------------------------------------------------------
-static void fn_value(int argc, char* const argv[], const cmd_t *cmd)
+// print error message with command help
+static void bad_args(const mrl_cmd_t *cmd)
+{
+  printf("error: bad number of arguments\r\n");
+  help_line(cmd);
+}
+//-----------------------------------------------------------------------------
+static void fn_value(void *ctx, int argc, char * const argv[],
+                     const mrl_cmd_t *cmd)
 {
   if (argc == 1)
     value = mrl_str2int(argv[0], 0, 0);
   
   if (argc > 1)
-#ifdef CLI_HELP
-    printf("error: bad number of arguments\r\n"
-           " %s\033[33m%s\033[0m - \033[32m%s\033[0m\r\n",
-           cmd->name, cmd->args, cmd->help);
-#else
-    printf("error: bad number of arguments\r\n");
-#endif
+    bad_args(cmd);
   else
     printf("val=%u\r\n", value);
 }
 //-----------------------------------------------------------------------------
-void fn_fl_page(int argc, char* const argv[], const cmd_t *cmd)
+static void fn_fl_page(void *ctx, int argc, char * const argv[],
+                       const mrl_cmd_t *cmd)
 {
   if (argc == 1)
     flash.page = mrl_str2int(argv[0], 0, 0);
   
   if (argc > 1)
-#ifdef CLI_HELP
-    printf("error: bad number of arguments\r\n"
-           " %s\033[33m%s\033[0m - \033[32m%s\033[0m\r\n",
-           cmd->name, cmd->args, cmd->help);
-#else
-    printf("error: bad number of arguments\r\n");
-#endif
+    bad_args(cmd);
   else
     printf("flash.pn=%u\r\n", flash.page);
 }
 //-----------------------------------------------------------------------------
-void fn_fl_erase(int argc, char* const argv[], const cmd_t *cmd)
+static void fn_fl_erase(void *ctx, int argc, char * const argv[],
+                        const mrl_cmd_t *cmd)
 {
   printf("FLASH erased (argc=%i)\r\n", argc);
 }
 //-----------------------------------------------------------------------------
-void fn_fl_erfull(int argc, char* const argv[], const cmd_t *cmd)
+static void fn_fl_erfull(void *ctx, int argc, char * const argv[],
+                         const mrl_cmd_t *cmd)
 {
   printf("FLASH full erased\r\n");
 }
 //-----------------------------------------------------------------------------
-#ifdef CLI_HELP
-#  define _F(id, parent_id, func, name, args, help) \
-   { id, parent_id, func, name, args, help }, // CLI help ON
-#else
-#  define _F(id, parent_id, func, name, args, help) \
-   { id, parent_id, func, name }, // CLI help OFF
-#endif
-
-#define _O(id, parent_id, func, name, args, help)
-//-----------------------------------------------------------------------------
 // all commands and options tree
-cmd_t const cmd_tree[] = {
-  //  ID  Par Callback     Name       Args    Help
-#ifdef CLI_HELP
-  _F(  0, -1, fn_help,     "help",    "",     "print this help") // it must be first!
-#endif
-  _F( 10, -1, fn_help,      "version", "",     "print version")
-  _F( 11, 10, fn_ver_mrl,   "microrl", "",     "print version of MicroRL")
-  _F( 12, 10, fn_ver_demo,  "demo",    "",     "print version of this demo test")
-  _F( 20, -1, fn_clear,     "clear",   "",     "clear screen")
-  _F( 30, -1, fn_value,     "value",   " val", "get/set 'value'")
-  _F( 40, -1, fn_help,      "flash",   "",     "FLASH parameters")
-  _F( 41, 40, fn_fl_page,   "page",    " pn",  "get/set FLASH page number")
-  _F( 42, 40, fn_fl_erase,  "erase",   "",     "erase FLASH")
-  _F( 43, 42, fn_fl_erfull, "full",    "",     "erase full FLASH")
-  _F( -1, -1, NULL,          NULL,     NULL,   NULL)
+// (sorted by parent ID and name, options of one command are neighbours)
+static const mrl_cmd_t cmd_tree[] = {
+  //      ID  Par Callback      Name       Args    Help
+  MRL_CMD( 20, -1, fn_clear,     "clear",   "",     "clear screen")
+  MRL_CMD( 40, -1, fn_help,      "flash",   "",     "FLASH parameters")
+  MRL_CMD(  0, -1, fn_help,      "help",    "",     "print this help")
+  MRL_CMD( 30, -1, fn_value,     "value",   " val", "get/set 'value'")
+  MRL_CMD( 10, -1, fn_help,      "version", "",     "print version")
+  MRL_CMD( 12, 10, fn_ver_demo,  "demo",    "",     "print version of this demo test")
+  MRL_CMD( 11, 10, fn_ver_mrl,   "microrl", "",     "print version of MicroRL")
+  MRL_CMD( 42, 40, fn_fl_erase,  "erase",   "",     "erase FLASH")
+  MRL_CMD( 41, 40, fn_fl_page,   "page",    " pn",  "get/set FLASH page number")
+  MRL_CMD( 43, 42, fn_fl_erfull, "full",    "",     "erase full FLASH")
+  MRL_CMD_END
 };
 //-----------------------------------------------------------------------------
-#undef _O
-#undef _F
-//-----------------------------------------------------------------------------
-// execute callback for microrl library
+// execute callback for microrl library (command is not found in tree)
 // do what you want here, but don't write to argv!!! read only!!
-static void execute_cb(int argc, char * const argv[])
-{
-  int i, parent_id = -1, arg_shift;
-  const cmd_t *found = (cmd_t*) NULL;
-
-#ifdef MRL_DEBUG
-  printf("argc=%i\r\n", argc);
-  for (i = 0; i < argc; i++)
-    printf("argv[%i]='%s'\r\n", i, argv[i]);
-  printf("argv[%i]=%p\r\n", argc, argv[argc]);
-#endif
-
-  for (i = 0; i < argc; i++)
-  {
-    const cmd_t *cmd = cmd_tree;
-    while (cmd->name != NULL)
-    {
-      if ((int) cmd->parent_id == parent_id && strcmp(cmd->name, argv[i]) == 0)
-      { // command/option found
-        found     = cmd;
-        parent_id = cmd->id;
-        arg_shift = i + 1;
-        break;
-      }
-      cmd++;
-    } // while
-  } // for
-
-  if (found != (cmd_t*) NULL) // command found
-    found->fn(argc - arg_shift, argv + arg_shift, found);
-  else
-    printf("command %s not found\r\n", argv[0]);
-}
-//-----------------------------------------------------------------------------
-#ifdef MRL_USE_COMPLETE
-// completion callback for microrl library
-static const char** complete_cb(int argc, char * const argv[])
+static void execute_cb(void *ctx, int argc, char * const argv[])
 {
-  int i, parent_id = -1, count = 0;
-
 #ifdef MRL_DEBUG
-  mrl_clear(&mrl);
+  int i;
   printf("argc=%i\r\n", argc);
   for (i = 0; i < argc; i++)
     printf("argv[%i]='%s'\r\n", i, argv[i]);
   printf("argv[%i]=%p\r\n", argc, argv[argc]);
-  mrl_refresh(&mrl);
 #endif
 
-  for (i = 0; i < argc ; i++)
-  {
-    const cmd_t *cmd = cmd_tree;
-    while (cmd->name != NULL)
-    {
-      if (cmd->parent_id == parent_id &&
-          strstr(cmd->name, argv[i]) == cmd->name &&
-          (parent_id != -1 || i == 0))
-      { // substring found => add it to completion set
-
-        if (i == argc - 1 && count < COMPL_NUM)
-          compl_world[count++] = cmd->name;
-
-        if (strcmp(cmd->name, argv[i]) == 0)
-        { // command/option full found
-          parent_id = cmd->id;
-          break;
-        }
-      }
-      cmd++;
-    } // while
-  } // for
-
-  compl_world[count] = NULL;
-  return compl_world;
+  printf("command %s not found\r\n", argv[0]);
 }
-#endif // MRL_USE_COMPLETE
 //-----------------------------------------------------------------------------
 // print callback for MicroRL library
-static void print(const char *str)
+static void print(void *ctx, const char *str)
 {
   fprintf(stdout, "%s", str);
 }
@@ -347,7 +215,7 @@ const int   prompt_len = 9;
 int main(int argc, char **argv)
 {
   // call init with ptr to microrl instance and print callback
-  mrl_init(&mrl, print);
+  mrl_init(&mrl, print, NULL); // no context
 
   // set custom prompt
   mrl_set_prompt(&mrl, prompt, prompt_len);
@@ -357,13 +225,23 @@ int main(int argc, char **argv)
   mrl_prompt(&mrl);
   //mrl_refresh(&mrl);
 
-  // set callback for execute
-  mrl_set_execute_cb(&mrl, execute_cb);
+#ifdef MRL_COMPLETE_WIDTH
+  { // completion variants are aligned by real terminal width
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0)
+      mrl_set_width(&mrl, ws.ws_col);
+  }
+#endif // MRL_COMPLETE_WIDTH
 
-#ifdef MRL_USE_COMPLETE
-  // set callback for completion
-  mrl_set_complete_cb(&mrl, complete_cb);
-#endif // MRL_USE_COMPLETE
+  // set command tree (TAB completes commands and options by tree)
+  if (!mrl_set_cmd(&mrl, cmd_tree))
+  {
+    printf("command tree is not sorted\n");
+    return 1;
+  }
+
+  // set callback for unknown command
+  mrl_set_execute_cb(&mrl, execute_cb);
 
   while (1)
   { // put received char from stdin to microrl lib
@@ -0,0 +1,1043 @@
+/*
+ * MicroRL library test unit #4 (non-interactive, count output bytes)
+ * File "mrl_test4.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h>
+#include <stdio.h>
+#include "mrl.h"
+//-----------------------------------------------------------------------------
+// MicroRL object
+static mrl_t mrl;
+
+// output counters
+static int bytes = 0; // number of printed bytes
+static int calls = 0; // number of 'print' callback calls
+static void *last_ctx = NULL; // context of last 'print' callback call
+
+// output log (beginning of output after put())
+static char out_log[256];
+static int out_len = 0;
+
+// number of failed checks
+static int errors = 0;
+//-----------------------------------------------------------------------------
+// print callback for MicroRL library (count output only)
+static void print(void *ctx, const char *str)
+{
+  int len = strlen(str);
+
+  if (out_len + len < (int) sizeof(out_log))
+  {
+    memcpy(out_log + out_len, str, len + 1);
+    out_len += len;
+  }
+
+  bytes += len;
+  calls++;
+  last_ctx = ctx;
+}
+//-----------------------------------------------------------------------------
+// put keys to MicroRL (return number of output bytes)
+static int put(const char *keys)
+{
+  bytes = calls = out_len = 0;
+  while (*keys != '\0')
+    mrl_insert_char(&mrl, (unsigned char) *keys++); // like getchar()
+  mrl_flush(&mrl);
+  return bytes;
+}
+//-----------------------------------------------------------------------------
+// check condition and print result
+static void check(const char *name, int ok)
+{
+  printf("%s: %s\r\n", ok ? "OK  " : "FAIL", name);
+  if (!ok) errors++;
+}
+//-----------------------------------------------------------------------------
+// output of library is sent before user callback (ENDL is printed last)
+static bool out_flushed()
+{
+  int len = strlen(MRL_ENDL);
+  return out_len >= len && strcmp(out_log + out_len - len, MRL_ENDL) == 0;
+}
+//-----------------------------------------------------------------------------
+// print one line of bytes per keystroke table
+static void row(const char *name, int keys, int out)
+{
+  printf("  %-24s %5i %7i %9.2f\r\n", name, keys, out, (double) out / keys);
+}
+//-----------------------------------------------------------------------------
+// typing at the end of line (fast path) vs typing inside line
+static void test_fast_path()
+{
+  const char *cmd = "flash erase full"; // 16 keys
+  int n = strlen(cmd), i, end_ins, mid_ins, end_bs, mid_bs;
+  char bs[64];
+
+  printf("bytes per keystroke:\r\n"
+         "  %-24s %5s %7s %9s\r\n", "case", "keys", "bytes", "bytes/key");
+
+  mrl_prompt(&mrl);
+  end_ins = put(cmd);
+  row("insert at end of line", n, end_ins);
+
+  put("\001"); // Ctrl+A (HOME)
+  mid_ins = put(cmd);
+  row("insert at begin of line", n, mid_ins);
+
+  for (i = 0; i < n; i++) bs[i] = '\177';
+  bs[n] = '\0';
+  mid_bs = put(bs); // cursor is in the middle of line
+  row("backspace inside line", n, mid_bs);
+
+  put("\005"); // Ctrl+E (END)
+  end_bs = put(bs);
+  row("backspace at end of line", n, end_bs);
+
+  check("append at end of line echo only one char", end_ins == n);
+  check("backspace at end of line send '\\b \\b'", end_bs == 3 * n);
+  check("insert at end of line cheaper than inside", end_ins < mid_ins);
+  check("backspace at end of line cheaper than inside", end_bs < mid_bs);
+  check("line content", strcmp(mrl.cmdline, "") == 0);
+}
+//-----------------------------------------------------------------------------
+// put keys to MicroRL by one mrl_insert_chars() call (return output bytes)
+static int put_chars(const char *keys, int *len)
+{
+  bytes = calls = 0;
+  mrl_insert_chars(&mrl, keys, len);
+  mrl_flush(&mrl);
+  return bytes;
+}
+//-----------------------------------------------------------------------------
+// paste of long text inside line: mrl_insert_char() vs mrl_insert_chars()
+static void test_bulk()
+{
+  char text[160], line[MRL_COMMAND_LINE_LEN];
+  const char *keys = "ab\004cd\030e"; // 'ab' Ctrl+D 'cd' Ctrl+X 'e'
+  int n = 150, i, len, one, one_calls, bulk, bulk_calls, code[3], done[3];
+
+  for (i = 0; i < n; i++) text[i] = 'a' + i % 26;
+  text[n] = '\0';
+
+  printf("paste of %i chars inside line:\r\n"
+         "  %-24s %5s %7s %9s\r\n", n, "case", "keys", "bytes", "bytes/key");
+
+  mrl_prompt(&mrl);
+  put("[]\002"); // '[]' and Ctrl+B
+  one = put(text);
+  one_calls = calls;
+  row("mrl_insert_char()", n, one);
+  strcpy(line, mrl.cmdline);
+
+  mrl_prompt(&mrl);
+  put("[]\002");
+  len = n;
+  bulk = put_chars(text, &len);
+  bulk_calls = calls;
+  row("mrl_insert_chars()", n, bulk);
+
+  check("same command line", strcmp(line, mrl.cmdline) == 0);
+  check("all chars processed", len == n);
+  check("paste by mrl_insert_chars() cheaper", bulk < one);
+#ifndef MRL_USE_OUTBUF
+  check("less 'print' calls", bulk_calls < one_calls);
+#else
+  check("output coalesced by buffer", one_calls <= n &&
+        bulk_calls <= bulk / (MRL_OUTBUF_LEN - 1) + 1);
+#endif // !MRL_USE_OUTBUF
+
+  // Ctrl+KEY codes must be returned in order
+  mrl_prompt(&mrl);
+  for (i = 0; i < 3; i++)
+  {
+    done[i] = len = strlen(keys);
+    code[i] = mrl_insert_chars(&mrl, keys, &done[i]);
+    keys += done[i];
+  }
+  check("Ctrl+D returned first",  code[0] == 4    && done[0] == 3);
+  check("Ctrl+X returned second", code[1] == 0x18 && done[1] == 3);
+  check("rest processed",         code[2] == 0    && done[2] == 1);
+  check("command line after keys", strcmp(mrl.cmdline, "abcde") == 0);
+
+  // bytes >= 0x80 (UTF-8) are inserted by both ways
+  keys = "caf\xC3\xA9 \xD0\xBF\xD0\xB8";
+  mrl_prompt(&mrl);
+  put(keys);
+  strcpy(line, mrl.cmdline);
+  mrl_prompt(&mrl);
+  len = strlen(keys);
+  put_chars(keys, &len);
+  check("UTF-8 by mrl_insert_char()", strcmp(line, keys) == 0);
+  check("UTF-8 by mrl_insert_chars()", strcmp(mrl.cmdline, keys) == 0 &&
+        len == (int) strlen(keys));
+  put("\025"); // Ctrl+U
+}
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_OUTBUF
+// output is sent before 'execute' callback
+static bool exec_flushed = false;
+//-----------------------------------------------------------------------------
+// 'execute' callback (check output of library only)
+static void exec_check(void *ctx, int argc, char * const argv[])
+{
+  exec_flushed = out_flushed();
+}
+//-----------------------------------------------------------------------------
+// output staging buffer: output of one key is sent by one 'print' call
+static void test_outbuf()
+{
+  int out;
+
+  printf("output buffer (%i bytes):\r\n", MRL_OUTBUF_LEN);
+  mrl_prompt(&mrl);
+  put("hello world\001"); // Ctrl+A
+  out = put("x");
+  printf("  insert at begin of line: %i bytes by %i 'print' calls\r\n",
+         out, calls);
+  check("one 'print' call per key", calls == 1 && out > 3);
+  put("\005\025"); // Ctrl+E, Ctrl+U
+
+  mrl_set_execute_cb(&mrl, exec_check);
+  put("run\r");
+  check("output is sent before 'execute'", exec_flushed);
+  mrl_set_execute_cb(&mrl, NULL);
+}
+#endif // MRL_USE_OUTBUF
+//-----------------------------------------------------------------------------
+#if defined(MRL_USE_SHADOW) && defined(MRL_USE_HISTORY)
+// shadow render: history recall send only chars after common prefix
+static void test_shadow()
+{
+  int out;
+
+  printf("shadow render:\r\n");
+  mrl_prompt(&mrl);
+  put("gpio set PA5 1\rgpio set PA5 0\r");
+  put("\020"); // UP
+  out = put("\020");
+  printf("  'gpio set PA5 0' -> 'gpio set PA5 1': %i bytes\r\n", out);
+  check("only changed char sent", out <= 2 && // '\b' and '1'
+        strcmp(mrl.cmdline, "gpio set PA5 1") == 0);
+  out = put("\016"); // DOWN
+  check("back to line with the same prefix", out <= 2 &&
+        strcmp(mrl.cmdline, "gpio set PA5 0") == 0);
+  put("\025\r"); // Ctrl+U, ENTER
+}
+#endif // MRL_USE_SHADOW && MRL_USE_HISTORY
+//-----------------------------------------------------------------------------
+#if !defined(MRL_PRINT_ESC_OFF) && !defined(MRL_ECHO_OFF)
+// long cursor jumps: the shortest sequence is sent
+static void test_cursor()
+{
+  char line[64];
+  int out;
+
+  printf("cursor jumps:\r\n");
+  mrl_prompt(&mrl); // "$ "
+  memset(line, 'x', 60);
+  line[60] = '\0';
+  put(line);
+
+  out = put("\001"); // Ctrl+A (HOME)
+#ifdef MRL_USE_CHA
+  check("HOME by ESC[3G (4 bytes)", out == 4 &&
+        strcmp(out_log, "\033[3G") == 0 && mrl.cursor == 0);
+#else
+  check("HOME by CR + ESC[2C (5 bytes)", out == 5 &&
+        strcmp(out_log, "\r\033[2C") == 0 && mrl.cursor == 0);
+#endif // MRL_USE_CHA
+
+  out = put("\005"); // Ctrl+E (END)
+  check("END by 5 bytes (ESC[60C or ESC[63G)", out == 5 && mrl.cursor == 60);
+
+  out = put("\002\002"); // Ctrl+B x 2 (no jump)
+  check("short move by backspaces", out == 2 && mrl.cursor == 58);
+
+  put("\025"); // Ctrl+U
+}
+#endif // !MRL_PRINT_ESC_OFF && !MRL_ECHO_OFF
+//-----------------------------------------------------------------------------
+// ESC sequences: word motions, unknown sequences, PgUp/PgDn
+static void test_escape()
+{
+  printf("ESC sequences:\r\n");
+
+  mrl_prompt(&mrl);
+  put("hello world foo");
+  put("\033[1;5D"); // Ctrl+LEFT
+  check("Ctrl+LEFT move to begin of word", mrl.cursor == 12);
+  put("\033b"); // Alt+B
+  check("Alt+B move to begin of word", mrl.cursor == 6);
+  put("\033[1;5C"); // Ctrl+RIGHT
+  check("Ctrl+RIGHT move to end of word", mrl.cursor == 11);
+  put("\033f"); // Alt+F
+  check("Alt+F move to end of word", mrl.cursor == 15);
+
+  put("\033[15~"       // F5
+      "\033[[A"        // F1 (Linux console)
+      "\033[?25h"      // private
+      "\033[1;2P"      // Shift+F1
+      "\033[2 q"       // intermediate char
+      "\033OP");       // F1 (SS3)
+  check("unknown sequences swallowed",
+        strcmp(mrl.cmdline, "hello world foo") == 0 && mrl.cursor == 15);
+
+  put("\033\001-"); // ESC aborted by Ctrl+A, '-'
+  check("control char abort sequence", mrl.cmdline[0] == '-');
+
+#ifdef MRL_USE_HISTORY
+  mrl_prompt(&mrl);
+  put("one\rtwo\rthree\rx");
+  put("\033[5~"); // PgUp
+  check("PgUp recall oldest line", strcmp(mrl.cmdline, "one") == 0);
+  put("\033[6~"); // PgDn
+  check("PgDn return to edited line", strcmp(mrl.cmdline, "x") == 0);
+#endif // MRL_USE_HISTORY
+}
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_INDEX
+// history index: number of lines is limited by index size
+static void test_hist_index()
+{
+  char cmd[16], old[16], last[16];
+  int i;
+
+  printf("history index (%i bytes):\r\n",
+         (int) (MRL_HIST_INDEX_LEN * sizeof(MRL_HIST_INDEX_TYPE)));
+
+  mrl_prompt(&mrl);
+  for (i = 0; i < MRL_HIST_INDEX_LEN + 2; i++)
+  {
+    sprintf(cmd, "cmd%i\r", i);
+    put(cmd);
+  }
+  sprintf(old,  "cmd%i", 2);
+  sprintf(last, "cmd%i", MRL_HIST_INDEX_LEN + 1);
+
+  put("\033[5~"); // PgUp
+  check("oldest lines deleted", strcmp(mrl.cmdline, old) == 0);
+  put("\033[A"); // UP
+  check("UP stop at oldest line", strcmp(mrl.cmdline, old) == 0);
+  for (i = 1; i < MRL_HIST_INDEX_LEN; i++)
+    put("\033[B"); // DOWN
+  check("DOWN to last line", strcmp(mrl.cmdline, last) == 0);
+  put("\033[B"); // DOWN
+  check("DOWN to empty line", mrl.cmdlen == 0);
+}
+#endif // MRL_USE_HIST_INDEX
+//-----------------------------------------------------------------------------
+#if defined(MRL_USE_HIST_SEARCH) && defined(MRL_USE_EXT_BUF)
+// reverse history search (Ctrl+R) in small ring buffer (lines wrap around)
+static void test_hist_search()
+{
+  static mrl_t hs;
+  static char line[16], hist[40];
+  static char *argv[4 + 2];
+  mrl_mem_t mem = { line, sizeof(line), NULL, hist, sizeof(hist), argv, 4 };
+  const char *keys;
+
+  printf("reverse history search:\r\n");
+  mrl_init_ext(&hs, &mem, print, NULL);
+
+  for (keys = "flash erase\rvalue 12\rflash page 3\rhelp\rx\022fla";
+       *keys != '\0'; keys++)
+    mrl_insert_char(&hs, *keys);
+  check("newest line found", hs.search && hs.search_pos == 21);
+  mrl_insert_char(&hs, '\022'); // Ctrl+R
+  mrl_insert_char(&hs, '\001'); // Ctrl+A
+  check("older line accepted", !hs.search && hs.cursor == 0 &&
+        strcmp(hs.cmdline, "flash erase") == 0);
+
+  for (keys = "\005\025\022vaX"; *keys != '\0'; keys++)
+    mrl_insert_char(&hs, *keys);
+  check("not found", hs.search_fail);
+  mrl_insert_char(&hs, '\b'); // BACKSPACE
+  check("found after BACKSPACE", !hs.search_fail && hs.search_pos == 12);
+  mrl_insert_char(&hs, '\007'); // Ctrl+G
+  check("cancel keep edited line", !hs.search && hs.cmdlen == 0);
+
+  for (keys = "ls\r\022ls"; *keys != '\0'; keys++) // "ls" wrap around
+    mrl_insert_char(&hs, *keys);
+  check("wrapped line found", !hs.search_fail);
+  mrl_insert_char(&hs, '\005'); // Ctrl+E
+  check("wrapped line accepted", strcmp(hs.cmdline, "ls") == 0);
+}
+#endif // MRL_USE_HIST_SEARCH && MRL_USE_EXT_BUF
+//-----------------------------------------------------------------------------
+#if defined(MRL_USE_HIST_PREFIX) && defined(MRL_USE_EXT_BUF)
+// UP/DOWN visit only history lines which start with text before cursor
+static void test_hist_prefix()
+{
+  static mrl_t hp;
+  static char line[16], hist[48];
+  static char *argv[4 + 2];
+  mrl_mem_t mem = { line, sizeof(line), NULL, hist, sizeof(hist), argv, 4 };
+  const char *keys;
+
+  printf("history prefix:\r\n");
+  mrl_init_ext(&hp, &mem, print, NULL);
+
+  for (keys = "flash erase\rflash page 3\rhelp\rflash ";
+       *keys != '\0'; keys++)
+    mrl_insert_char(&hp, *keys);
+  bytes = 0;
+  mrl_insert_char(&hp, '\020'); // Ctrl+P
+  check("UP skip not matched lines",
+        strcmp(hp.cmdline, "flash page 3") == 0 && bytes <= 20);
+  mrl_insert_char(&hp, '\020'); // Ctrl+P
+  check("UP to older matched line", strcmp(hp.cmdline, "flash erase") == 0);
+  mrl_insert_char(&hp, '\020'); // Ctrl+P
+  check("UP stop at oldest matched line",
+        strcmp(hp.cmdline, "flash erase") == 0);
+  mrl_insert_char(&hp, '\016'); // Ctrl+N
+  check("DOWN to newer matched line", strcmp(hp.cmdline, "flash page 3") == 0);
+  mrl_insert_char(&hp, '\016'); // Ctrl+N
+  check("DOWN to edited line", strcmp(hp.cmdline, "flash ") == 0);
+
+  for (keys = "\025\rls -la /tmp/x\rlog\rls"; // line wrap around
+       *keys != '\0'; keys++)
+    mrl_insert_char(&hp, *keys);
+  mrl_insert_char(&hp, '\020'); // Ctrl+P
+  check("wrapped line found", strcmp(hp.cmdline, "ls -la /tmp/x") == 0);
+  mrl_insert_char(&hp, '\020'); // Ctrl+P
+  check("no older wrapped line", strcmp(hp.cmdline, "ls -la /tmp/x") == 0);
+}
+#endif // MRL_USE_HIST_PREFIX && MRL_USE_EXT_BUF
+//-----------------------------------------------------------------------------
+#if defined(MRL_USE_HIST_DEDUP) && defined(MRL_USE_EXT_BUF)
+// history without duplicates (saved line delete earlier identical line)
+static void test_hist_dedup()
+{
+  static mrl_t hd;
+  static char line[16], hist[32];
+  static char *argv[4 + 2];
+  mrl_mem_t mem = { line, sizeof(line), NULL, hist, sizeof(hist), argv, 4 };
+  const char *keys;
+  int i;
+
+  printf("history without duplicates (%i bytes):\r\n",
+         (int) (MRL_HIST_DEDUP_LEN * sizeof(MRL_HIST_DEDUP_TYPE)));
+  mrl_init_ext(&hd, &mem, print, NULL);
+
+  for (keys = "help\r"; *keys != '\0'; keys++)
+    mrl_insert_char(&hd, *keys);
+  for (i = 0; i < 10; i++)
+    for (keys = "value\rflash page\r"; *keys != '\0'; keys++)
+      mrl_insert_char(&hd, *keys);
+  mrl_insert_char(&hd, '\020'); // Ctrl+P
+  check("newest line", strcmp(hd.cmdline, "flash page") == 0);
+  mrl_insert_char(&hd, '\020'); // Ctrl+P
+  check("previous line is not duplicate", strcmp(hd.cmdline, "value") == 0);
+  mrl_insert_char(&hd, '\020'); // Ctrl+P
+  check("oldest line is kept", strcmp(hd.cmdline, "help") == 0);
+  mrl_insert_char(&hd, '\020'); // Ctrl+P
+  check("no more lines", strcmp(hd.cmdline, "help") == 0);
+
+  for (keys = "\005\025\rhelp\r"; *keys != '\0'; keys++)
+    mrl_insert_char(&hd, *keys);
+  mrl_insert_char(&hd, '\033'); // PgUp
+  mrl_insert_char(&hd, '[');
+  mrl_insert_char(&hd, '5');
+  mrl_insert_char(&hd, '~');
+  check("oldest line moved to front", strcmp(hd.cmdline, "value") == 0);
+
+  mrl_insert_char(&hd, '\025'); // Ctrl+U
+  for (i = 0; i < MRL_HIST_DEDUP_LEN; i++)
+  { // short different lines
+    mrl_insert_char(&hd, 'a' + i);
+    mrl_insert_char(&hd, '\r');
+  }
+  check("hashes table is not full", hd.hist.hashes < MRL_HIST_DEDUP_LEN);
+}
+#endif // MRL_USE_HIST_DEDUP && MRL_USE_EXT_BUF
+//-----------------------------------------------------------------------------
+#if defined(MRL_USE_HIST_SNAPSHOT) && defined(MRL_USE_EXT_BUF)
+// snapshot and journal of history (for example in flash)
+static char flash[256];
+static int flash_len = 0;
+//-----------------------------------------------------------------------------
+// 'write' callback of mrl_hist_export() (header, then ring buffer)
+static int flash_write(void *ctx, const void *buf, int len)
+{
+  if (len > (int) sizeof(flash) - flash_len) return -1;
+  memcpy(flash + flash_len, buf, len);
+  flash_len += len;
+  return len;
+}
+//-----------------------------------------------------------------------------
+// 'journal' callback (append line with '\0' to journal)
+static char journal[64];
+static int journal_len = 0;
+static void journal_add(void *ctx, const char *str)
+{
+  int len = strlen(str) + 1;
+  if (len > (int) sizeof(journal) - journal_len) return;
+  memcpy(journal + journal_len, str, len);
+  journal_len += len;
+}
+//-----------------------------------------------------------------------------
+// put keys to object and return command line after UP (Ctrl+P)
+static const char *hist_up(mrl_t *obj, const char *keys)
+{
+  while (*keys != '\0')
+    mrl_insert_char(obj, *keys++);
+  mrl_insert_char(obj, '\020'); // Ctrl+P
+  return obj->cmdline;
+}
+//-----------------------------------------------------------------------------
+static void test_hist_snapshot()
+{
+  static mrl_t a, b;
+  static char line[16], hist_a[48], hist_b[40], snap[256];
+  static char *argv[4 + 2];
+  mrl_mem_t mem_a = { line, sizeof(line), NULL, hist_a, sizeof(hist_a),
+                      argv, 4 };
+  mrl_mem_t mem_b = { line, sizeof(line), NULL, hist_b, sizeof(hist_b),
+                      argv, 4 };
+
+  printf("history snapshot:\r\n");
+  mrl_init_ext(&a, &mem_a, print, NULL);
+  hist_up(&a, "flash erase\rvalue 12\rflash page 3\rhelp\r\025");
+
+  flash_len = 0;
+  check("export", mrl_hist_export(&a, flash_write, NULL) ==
+        (int) sizeof(mrl_snap_t) + (int) sizeof(hist_a) &&
+        flash_len == mrl_hist_snap_size(&a));
+  check("checksum", mrl_hist_snap_check(flash, flash_len));
+  flash[flash_len - 1] ^= 1;
+  check("broken snapshot", !mrl_hist_snap_check(flash, flash_len) &&
+        !mrl_hist_import(&a, flash, flash_len));
+  flash[flash_len - 1] ^= 1;
+
+  mrl_init_ext(&a, &mem_a, print, NULL);
+  check("import", mrl_hist_import(&a, flash, flash_len) &&
+        strcmp(hist_up(&a, ""), "help") == 0);
+
+  memcpy(snap, flash, flash_len);
+  mrl_init_ext(&b, &mem_b, print, NULL);
+  check("adopt", mrl_hist_adopt(&b, snap, flash_len) &&
+        b.hist.buf == snap + sizeof(mrl_snap_t) &&
+        strcmp(hist_up(&b, "\025"), "help") == 0);
+
+  journal_len = 0;
+  mrl_set_journal_cb(&b, journal_add);
+  check("journal",
+        strcmp(hist_up(&b, "\025ls\r\025  ls -l\r\025"), "ls -l") == 0 &&
+        journal_len == 9 && memcmp(journal, "ls\0ls -l\0", 9) == 0);
+
+  mrl_init_ext(&a, &mem_a, print, NULL);
+  mrl_hist_import(&a, flash, flash_len);
+  journal[journal_len] = 'x'; // incomplete line (power off while writing)
+  check("replay", mrl_hist_replay(&a, journal, journal_len + 1) == 2 &&
+        strcmp(hist_up(&a, ""), "ls -l") == 0 &&
+        strcmp(hist_up(&a, ""), "ls") == 0 &&
+        strcmp(hist_up(&a, ""), "help") == 0);
+
+  mrl_init_ext(&b, &mem_b, print, NULL);
+  check("import to other ring buffer",
+        mrl_hist_import(&b, flash, flash_len) &&
+        strcmp(hist_up(&b, ""), "help") == 0 &&
+        strcmp(hist_up(&b, ""), "flash page 3") == 0);
+}
+#endif // MRL_USE_HIST_SNAPSHOT && MRL_USE_EXT_BUF
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_RXQ
+// RX queue: overflow counter, high water mark, wrap of ring buffer
+static void test_rxq()
+{
+  const char *keys = "0123456789abcdefXYZ"; // 16 + 3 chars
+  int i, n = strlen(keys), pushed = 0;
+
+  printf("RX queue (%i chars):\r\n", MRL_RXQ_LEN);
+
+  mrl_prompt(&mrl);
+  for (i = 0; i < n; i++)
+    pushed += mrl_rx_push(&mrl, keys[i]);
+  check("push to full queue fail", pushed == MRL_RXQ_LEN);
+  check("lost chars counted", mrl.rxq_lost == (unsigned) (n - MRL_RXQ_LEN));
+  check("high water mark", mrl.rxq_max == MRL_RXQ_LEN);
+
+  mrl_process(&mrl);
+  check("all queued chars handled",
+        strcmp(mrl.cmdline, "0123456789abcdef") == 0);
+
+  mrl_prompt(&mrl);
+  for (i = 0; i < 10; i++) mrl_rx_push(&mrl, keys[i]);
+  mrl_process(&mrl);
+  for (i = 0; i < 10; i++) mrl_rx_push(&mrl, keys[i]); // wrap
+  check("Ctrl+D returned from queue",
+        mrl_rx_push(&mrl, '\004') && mrl_rx_push(&mrl, '-') &&
+        mrl_process(&mrl) == 4);
+  mrl_process(&mrl);
+  check("wrap of ring buffer",
+        strcmp(mrl.cmdline, "01234567890123456789-") == 0);
+
+  // bytes >= 0x80 (UTF-8) from UART (0xC3 0xA9 - e with acute)
+  mrl_prompt(&mrl);
+  mrl_rx_push(&mrl, 'e');
+  mrl_rx_push(&mrl, 0xC3);
+  mrl_rx_push(&mrl, 0xA9);
+  mrl_process(&mrl);
+  check("bytes >= 0x80 passed by queue",
+        strcmp(mrl.cmdline, "e\xC3\xA9") == 0);
+}
+#endif // MRL_USE_RXQ
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_TICK
+static int idle_calls = 0;
+
+// idle callback
+static void idle(void *ctx)
+{
+  idle_calls++;
+}
+//-----------------------------------------------------------------------------
+// ESC timeout and idle callback by mrl_tick()
+static void test_tick()
+{
+  int rv;
+
+  printf("mrl_tick():\r\n");
+
+  mrl_prompt(&mrl);
+  put("ab\033"); // bare ESC
+  mrl_tick(&mrl, 1000);
+  rv = mrl_tick(&mrl, 1000 + MRL_ESC_TIMEOUT - 1);
+  check("ESC wait before timeout", rv == 0 && mrl.escape_seq);
+  rv = mrl_tick(&mrl, 1000 + MRL_ESC_TIMEOUT);
+  check("bare ESC resolved after timeout", rv == '\033');
+  put("c");
+  check("key after bare ESC not swallowed", strcmp(mrl.cmdline, "abc") == 0);
+
+  put("\033[1;"); // half-received sequence
+  mrl_tick(&mrl, 2000);
+  rv = mrl_tick(&mrl, 2000 + MRL_ESC_TIMEOUT);
+  put("5");
+  check("half-received sequence dropped",
+        rv == 0 && strcmp(mrl.cmdline, "abc5") == 0);
+
+  mrl_set_idle_cb(&mrl, 1000, idle);
+  mrl_tick(&mrl, 2999);
+  mrl_tick(&mrl, 3100);
+  check("no idle callback before idle period", idle_calls == 0);
+  mrl_tick(&mrl, 3100 + 1000);
+  mrl_tick(&mrl, 3100 + 2000);
+  check("idle callback every idle period", idle_calls == 2);
+  put("x");
+  mrl_tick(&mrl, 5500);
+  mrl_tick(&mrl, 6499);
+  check("input restart idle period", idle_calls == 2);
+  mrl_tick(&mrl, 6500);
+  check("idle callback after input", idle_calls == 3);
+
+  // wrap of time counter
+  put("y");
+  mrl_tick(&mrl, 0xFFFFFF00);
+  mrl_tick(&mrl, 0xFFFFFF00 + 1000);
+  check("wrap of time counter", idle_calls == 4);
+  mrl_set_idle_cb(&mrl, 0, NULL);
+
+#ifdef MRL_USE_PASTE
+  mrl_prompt(&mrl);
+  put("\033[200~ab"); // pause inside paste (slow link)
+  mrl_tick(&mrl, 10000);
+  mrl_tick(&mrl, 10000 + MRL_ESC_TIMEOUT);
+  mrl_tick(&mrl, 10000 + MRL_PASTE_TIMEOUT - 1);
+  check("paste is not ended by pause", mrl.paste != 0);
+  put("\tc\033[201~");
+  check("rest of paste inserted as is",
+        strcmp(mrl.cmdline, "ab c") == 0 && !mrl.paste);
+
+  put("\033[200~d"); // end of paste lost
+  mrl_tick(&mrl, 20000);
+  mrl_tick(&mrl, 20000 + MRL_PASTE_TIMEOUT);
+  check("paste ended by timeout",
+        strcmp(mrl.cmdline, "ab cd") == 0 && !mrl.paste);
+  put("\025"); // Ctrl+U
+#endif // MRL_USE_PASTE
+}
+#endif // MRL_USE_TICK
+//-----------------------------------------------------------------------------
+// copy tokens for use after 'execute' callback return
+static void test_argv_copy()
+{
+  char line[] = "flash erase full", *argv[4], *copy[4], buf[32];
+  int used;
+
+  printf("argv copy:\r\n");
+  argv[0] = line; argv[1] = line + 6; argv[2] = line + 12; argv[3] = NULL;
+  line[5] = line[11] = '\0';
+
+  check("small buffer", mrl_argv_copy(buf, 16, copy, 3, argv) == -1);
+
+  used = mrl_argv_copy(buf, sizeof(buf), copy, 3, argv);
+  memset(line, '~', sizeof(line) - 1); // command line is reused
+  check("tokens copied", used == 17 && strcmp(copy[0], "flash") == 0 &&
+        strcmp(copy[2], "full") == 0 && copy[3] == NULL);
+}
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_COMPLETE
+// number of streaming completion callback calls
+static int compl_calls = 0;
+//-----------------------------------------------------------------------------
+// streaming completion callback: 1000 interfaces "eth0".."eth999"
+// and "lo" (variant strings are made in one temporary buffer)
+static void compl_ifaces(void *ctx, int argc, char * const argv[],
+                         mrl_compl_t *compl)
+{
+  const char *last = argv[argc - 1];
+  char name[16];
+  int i;
+
+  compl_calls++;
+  for (i = 0; i < 1000; i++)
+  {
+    sprintf(name, "eth%i", i);
+    if (strncmp(name, last, strlen(last)) == 0)
+      mrl_compl_add(compl, name);
+  }
+  if (strncmp("lo", last, strlen(last)) == 0)
+    mrl_compl_add(compl, "lo");
+}
+//-----------------------------------------------------------------------------
+// streaming completion: many variants without array
+static void test_compl_stream()
+{
+  int out;
+
+  printf("streaming completion:\r\n");
+  mrl_set_compl_cb(&mrl, compl_ifaces);
+  mrl_prompt(&mrl);
+
+  compl_calls = 0;
+  out = put("up e\t");
+  printf("  1000 variants: %i bytes\r\n", out);
+  check("common part inserted", strcmp(mrl.cmdline, "up eth") == 0);
+  check("all variants printed (two passes)",
+        compl_calls == 2 && out > 1000 * 5);
+
+  compl_calls = 0;
+  put("99\t");
+  check("variants after common part", strcmp(mrl.cmdline, "up eth99") == 0);
+  put("7\t");
+#ifdef MRL_USE_COMPL_CACHE
+  check("one variant (from cache)", compl_calls == 1 &&
+#else
+  check("one variant (one pass)", compl_calls == 3 &&
+#endif // MRL_USE_COMPL_CACHE
+        strcmp(mrl.cmdline, "up eth997 ") == 0);
+
+  put("\025up x\t");
+  check("no variants", strcmp(mrl.cmdline, "up x") == 0);
+  put("\025");
+
+#ifdef MRL_COMPLETE_WIDTH
+  put("up e");
+  put("\t");
+  printf("  %i rows of 1000 variants by %i 'print' calls\r\n",
+         (1000 + 9) / 10, calls);
+#ifdef MRL_USE_OUTBUF
+  check("rows coalesced by buffer", // + flush before each callback call
+        calls <= bytes / (MRL_OUTBUF_LEN - 1) + 1 + 2);
+#else
+  check("one 'print' call per row", calls < 1 + 100 + 10); // + prompt, line
+#endif // MRL_USE_OUTBUF
+
+  mrl_set_width(&mrl, 20);
+  put("\025up eth99");
+  put("\t");
+  check("aligned columns by terminal width", strncmp(out_log,
+        "\r\neth99   eth990\r\neth991  eth992\r\n", 34) == 0);
+  mrl_set_width(&mrl, MRL_COMPLETE_WIDTH);
+  put("\025");
+#endif // MRL_COMPLETE_WIDTH
+
+  mrl_set_compl_cb(&mrl, NULL);
+}
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_COMPL_CACHE
+// completion cache: callback is not called for longer token
+static void test_compl_cache()
+{
+  printf("completion cache (%i bytes):\r\n", MRL_COMPL_CACHE_LEN);
+  mrl_set_compl_cb(&mrl, compl_ifaces);
+
+  compl_calls = 0;
+  put("up eth99\t");
+  check("one call for list of variants", compl_calls == 1);
+  put("9\t");
+  check("longer token filters cache", compl_calls == 1 &&
+        strcmp(mrl.cmdline, "up eth999 ") == 0);
+  put("\025up eth99\t");
+  check("same line typed again", compl_calls == 1);
+
+  put("\025dn eth99\t");
+  check("changed line before token drops cache", compl_calls == 2);
+  put("\025dn eth\t");
+  check("shorter token drops cache", compl_calls == 4); // cache is full
+
+  put("\025\rdn eth99\t");
+  check("ENTER drops cache", compl_calls == 5);
+  mrl_compl_reset(&mrl);
+  put("7\t");
+  check("cache dropped by mrl_compl_reset()", compl_calls == 6 &&
+        strcmp(mrl.cmdline, "dn eth997 ") == 0);
+  put("\025");
+
+  mrl_set_compl_cb(&mrl, NULL);
+}
+#endif // MRL_USE_COMPL_CACHE
+#endif // MRL_USE_COMPLETE
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_CMD
+// last called handler and its arguments
+static const char *cmd_called = NULL;
+static int cmd_argc = -1;
+static const char *cmd_arg0 = NULL;
+static bool cmd_flushed = false; // output is sent before handler
+//-----------------------------------------------------------------------------
+// handler of command tree record
+static void cmd_fn(void *ctx, int argc, char * const argv[],
+                   const mrl_cmd_t *cmd)
+{
+  cmd_called = cmd->name;
+  cmd_argc   = argc;
+  cmd_arg0   = argc > 0 ? argv[0] : NULL;
+  cmd_flushed = out_flushed();
+}
+//-----------------------------------------------------------------------------
+// 'execute' callback (command not found in tree)
+static void cmd_unknown(void *ctx, int argc, char * const argv[])
+{
+  cmd_called = "?";
+  cmd_argc   = argc;
+}
+//-----------------------------------------------------------------------------
+// command tree: dispatch and completion by binary search
+static void test_cmd()
+{
+  static const mrl_cmd_t tree[] = {
+    MRL_CMD(1, -1, cmd_fn, "flash", "", "")
+    MRL_CMD(2, -1, cmd_fn, "gpio",  "", "")
+    MRL_CMD(3, -1, NULL,   "help",  "", "")
+    MRL_CMD(4,  1, cmd_fn, "erase", "", "")
+    MRL_CMD(5,  1, cmd_fn, "read",  "", "")
+    MRL_CMD(6,  2, cmd_fn, "get",   "", "")
+    MRL_CMD(7,  2, cmd_fn, "set",   "", "")
+    MRL_CMD(8,  2, cmd_fn, "setup", "", "")
+    MRL_CMD(9,  4, cmd_fn, "full",  "", "")
+    MRL_CMD_END
+  };
+  static const mrl_cmd_t unsorted[] = {
+    MRL_CMD(1, -1, cmd_fn, "gpio",  "", "")
+    MRL_CMD(2, -1, cmd_fn, "flash", "", "")
+    MRL_CMD_END
+  };
+  int num;
+
+  printf("command tree:\r\n");
+
+  check("unsorted tree is not set", !mrl_set_cmd(&mrl, unsorted) &&
+        mrl.cmd == NULL);
+  check("tree is set", mrl_set_cmd(&mrl, tree) && mrl.cmd_num == 9);
+  mrl_set_execute_cb(&mrl, cmd_unknown);
+  mrl_prompt(&mrl);
+
+  put("gpio set PA5 1\r");
+  check("option handler get arguments", cmd_called == tree[6].name &&
+        cmd_argc == 2 && strcmp(cmd_arg0, "PA5") == 0);
+  check("output is sent before handler", cmd_flushed);
+  put("flash erase full\r");
+  check("option of option", cmd_called == tree[8].name && cmd_argc == 0);
+  put("flash 0x100 erase\r");
+  check("argument stops search", cmd_called == tree[0].name && cmd_argc == 2);
+  put("help\r");
+  check("command without handler goes to 'execute'",
+        strcmp(cmd_called, "?") == 0 && cmd_argc == 1);
+  put("reset now\r");
+  check("unknown command goes to 'execute'",
+        strcmp(cmd_called, "?") == 0 && cmd_argc == 2);
+
+  check("root commands", mrl_cmd_children(&mrl, -1, &num) == tree &&
+        num == 3);
+  check("options of 'gpio'", mrl_cmd_children(&mrl, 2, &num) == tree + 5 &&
+        num == 3);
+  check("no options of 'help'", (mrl_cmd_children(&mrl, 3, &num), num == 0));
+  check("find by ID", mrl_cmd_by_id(&mrl, 9) == tree + 8 &&
+        mrl_cmd_by_id(&mrl, 10) == NULL);
+
+#ifdef MRL_USE_COMPLETE
+  put("gp\t");
+  check("TAB complete command", strcmp(mrl.cmdline, "gpio ") == 0);
+  put("s\t");
+  check("TAB complete common part of options",
+        strcmp(mrl.cmdline, "gpio set") == 0);
+  put(" PA5 \t");
+  check("TAB don't complete arguments",
+        strcmp(mrl.cmdline, "gpio set PA5 ") == 0);
+  put("\025fl\t\t");
+  check("TAB complete option", strcmp(mrl.cmdline, "flash ") == 0);
+  put("e\tf\t");
+  check("TAB complete option of option",
+        strcmp(mrl.cmdline, "flash erase full ") == 0);
+  put("\025");
+#endif // MRL_USE_COMPLETE
+
+  mrl_set_cmd(&mrl, NULL);
+  mrl_set_execute_cb(&mrl, NULL);
+}
+#endif // MRL_USE_CMD
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_EXT_BUF
+// small caller-owned buffers: 16 bytes line, no history, 2 tokens
+static void test_ext_buf()
+{
+  static mrl_t small;
+  static char line[16];
+  static char *argv[2 + 2];
+  mrl_mem_t mem = { line, sizeof(line), NULL, NULL, 0, argv, 2 };
+  const char *keys = "0123456789abcdefXYZ\r\033[A";
+
+  printf("caller-owned buffers (%i bytes):\r\n",
+         (int) (sizeof(small) + sizeof(line) + sizeof(argv)));
+
+  mrl_init_ext(&small, &mem, print, &small);
+  mrl_prompt(&small);
+  while (*keys != '\0')
+  {
+    mrl_insert_char(&small, *keys++);
+    if (*keys == '\r')
+      check("line limited by buffer size",
+            strcmp(small.cmdline, "0123456789abcde") == 0);
+  }
+  check("no history", small.cmdlen == 0);
+  check("context passed to callback", last_ctx == &small);
+
+#ifdef MRL_USE_SHADOW
+  // no shadow buffer: command line is reprinted on each change
+  mrl_insert_char(&small, 'a');
+  mrl_insert_char(&small, '\002'); // Ctrl+B
+  out_len = 0;
+  mrl_insert_char(&small, 'b');
+  mrl_flush(&small);
+  check("full redraw without shadow buffer", strstr(out_log, "ba") != NULL &&
+        strcmp(small.cmdline, "ba") == 0);
+#endif // MRL_USE_SHADOW
+}
+#endif // MRL_USE_EXT_BUF
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_PASTE
+// bracketed paste: text inserted as is with one redraw
+static void test_paste()
+{
+  int out;
+
+  printf("bracketed paste:\r\n");
+
+  mrl_prompt(&mrl);
+  out = put("\033[200~show\tver\r\nset x 1\003\033[201~");
+  printf("  %i bytes by %i 'print' calls\r\n", out, calls);
+
+#if defined(MRL_PASTE_NL_SPACE)
+  check("TAB and CR+LF replaced by space",
+        strcmp(mrl.cmdline, "show ver set x 1") == 0);
+#elif defined(MRL_PASTE_NL_DROP)
+  check("TAB replaced by space, CR+LF dropped",
+        strcmp(mrl.cmdline, "show verset x 1") == 0);
+#endif
+#ifdef MRL_USE_SHADOW
+  check("one redraw at end of paste (changed chars only)",
+        out == (int) strlen(mrl.cmdline));
+#else
+  check("one redraw at end of paste (ESC[K + line)",
+        out == 3 + (int) strlen(mrl.cmdline));
+#endif // MRL_USE_SHADOW
+
+  put("\033[1~-"); // HOME and '-'
+  check("keys work after paste", mrl.cmdline[0] == '-');
+
+  put("\005\025"); // END, Ctrl+U
+  put("\033[200~ab\033[Acd\033[1;5Def\033OPgh\033[20~ij\033[201~");
+  check("ESC sequences inside paste swallowed",
+        strcmp(mrl.cmdline, "abcdefghij") == 0 && !mrl.paste);
+  put("\025"); // Ctrl+U
+}
+#endif // MRL_USE_PASTE
+//-----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  // call init with ptr to microrl instance and print callback
+#ifdef MRL_USE_EXT_BUF
+  static char line[MRL_COMMAND_LINE_LEN], hist[MRL_RING_HISTORY_LEN];
+  static char *tokens[MRL_COMMAND_TOKEN_NUM + 2];
+#ifdef MRL_USE_SHADOW
+  static char shadow[MRL_COMMAND_LINE_LEN];
+#else
+  char *shadow = NULL;
+#endif // MRL_USE_SHADOW
+  mrl_mem_t mem = { line, sizeof(line), shadow, hist, sizeof(hist),
+                    tokens, MRL_COMMAND_TOKEN_NUM };
+  mrl_init_ext(&mrl, &mem, print, NULL);
+#else
+  mrl_init(&mrl, print, NULL);
+#endif // MRL_USE_EXT_BUF
+
+  test_fast_path();
+  test_bulk();
+#ifdef MRL_USE_OUTBUF
+  test_outbuf();
+#endif
+#if defined(MRL_USE_SHADOW) && defined(MRL_USE_HISTORY)
+  test_shadow();
+#endif
+#if !defined(MRL_PRINT_ESC_OFF) && !defined(MRL_ECHO_OFF)
+  test_cursor();
+#endif
+  test_escape();
+#ifdef MRL_USE_RXQ
+  test_rxq();
+#endif
+#ifdef MRL_USE_TICK
+  test_tick();
+#endif
+  test_argv_copy();
+#ifdef MRL_USE_HIST_INDEX
+  test_hist_index();
+#endif
+#if defined(MRL_USE_HIST_SEARCH) && defined(MRL_USE_EXT_BUF)
+  test_hist_search();
+#endif
+#if defined(MRL_USE_HIST_PREFIX) && defined(MRL_USE_EXT_BUF)
+  test_hist_prefix();
+#endif
+#if defined(MRL_USE_HIST_DEDUP) && defined(MRL_USE_EXT_BUF)
+  test_hist_dedup();
+#endif
+#if defined(MRL_USE_HIST_SNAPSHOT) && defined(MRL_USE_EXT_BUF)
+  test_hist_snapshot();
+#endif
+#ifdef MRL_USE_COMPLETE
+  test_compl_stream();
+#endif
+#ifdef MRL_USE_COMPL_CACHE
+  test_compl_cache();
+#endif
+#ifdef MRL_USE_CMD
+  test_cmd();
+#endif
+#ifdef MRL_USE_EXT_BUF
+  test_ext_buf();
+#endif
+#ifdef MRL_USE_PASTE
+  test_paste();
+#endif
+
+  printf("%s (%i errors)\r\n", errors ? "FAILED" : "PASSED", errors);
+  return errors ? 1 : 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "mrl_test4.c" file ***/
@@ -0,0 +1,971 @@
+/*
+ * MicroRL library test #5 (multi-session console server)
+ * File "mrl_test5.c"
+ *
+ * Server: N sessions on ptys and on local TCP socket in one thread (epoll),
+ *   slow commands may be executed by pool of worker threads (output of
+ *   commands is sent to session in order, prompt stays responsive),
+ *   all sessions see one history (if MRL_USE_HIST_SHARED is defined),
+ *   mrl_test5 [-p port] [-n ptys] [-t idle_sec] [-w workers]
+ *   connect: "screen /dev/pts/X" or "socat -,raw,echo=0 tcp:127.0.0.1:2323"
+ *   Ctrl+C - print statistics and exit
+ *
+ * Load generator (run in other terminal):
+ *   mrl_test5 -l [-p port] [-c sessions] [-d sec] [-k keys_per_write]
+ */
+
+//-----------------------------------------------------------------------------
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include "mrl.h"
+//-----------------------------------------------------------------------------
+#define PORT_DEFAULT  2323 // TCP port (127.0.0.1 only)
+#define SESSIONS_MAX  8192 // max number of sessions
+#define IDLE_SEC       300 // close TCP session after N seconds without input
+#define RX_LEN        4096 // read() buffer size
+#define TX_LEN        8192 // output buffer size (per session)
+#define TICK_MS        100 // mrl_tick() period [ms]
+#define EVENTS_MAX     256 // max number of events by one epoll_wait() call
+#define WORKERS_MAX     64 // max number of worker threads
+#define JOB_OUT_LEN   2048 // command output buffer size (rest is dropped)
+
+// load generator command (server answer by 2 lines: echo of command + output)
+#define LOAD_CMD "echo 0123456789 abcdefghij\r"
+//-----------------------------------------------------------------------------
+typedef struct session_ session_t;
+typedef struct job_ job_t;
+//-----------------------------------------------------------------------------
+// command (output is put to job buffer, not to session)
+typedef struct {
+  const char *name;
+  void (*fn)(job_t *job, int argc, char * const argv[]);
+  bool slow; // executed by worker thread (if any)
+} cmd_t;
+//-----------------------------------------------------------------------------
+// command execution job (arguments are copied from command line)
+struct job_ {
+  session_t *s;      // owner session
+  const cmd_t *cmd;  // command or NULL if not found
+  job_t *next;       // next job in pool queue or in done list
+  job_t *snext;      // next job of session (output order)
+  bool done;         // output is ready (I/O thread only)
+  bool quit;         // close session after output
+  int argc;
+  char *argv[MRL_COMMAND_TOKEN_NUM + 1];
+  char args[MRL_COMMAND_LINE_LEN];
+  int outlen;
+  char out[JOB_OUT_LEN + 1];
+};
+//-----------------------------------------------------------------------------
+// one session (pty or TCP connection)
+struct session_ {
+  mrl_t mrl;       // MicroRL object (callbacks context is session)
+  int fd;          // pty master or TCP socket (-1 if closed)
+  int slave;       // pty slave (kept open to avoid EPOLLHUP) or -1
+  int idx;         // index in sessions table
+  bool close;      // close session after output sent
+  bool pollout;    // EPOLLOUT is enabled
+  int txoff;       // offset of first unsent char
+  int txlen;       // number of chars in output buffer
+  char tx[TX_LEN]; // output buffer
+  session_t *next; // next closed session (freed after events batch)
+  job_t *head;     // first job of session (output is not sent yet)
+  job_t *tail;     // last job of session
+  int jobs;        // number of jobs (closed session is freed if 0)
+#ifdef MRL_USE_COMPLETE
+  const char *compl[16]; // completion variants (NULL terminated)
+#endif
+};
+//-----------------------------------------------------------------------------
+// server state
+static int ep = -1;                            // epoll descriptor
+static session_t *sessions[SESSIONS_MAX];      // active sessions
+static int session_num = 0;                    // number of active sessions
+static int session_peak = 0;                   // max number of sessions
+static session_t *closed = NULL;               // closed sessions list
+static unsigned long long keys = 0, cmds = 0;  // statistics
+static volatile sig_atomic_t stop = 0;         // Ctrl+C pressed
+static unsigned idle_ms = IDLE_SEC * 1000;
+#ifdef MRL_USE_HIST_SHARED
+static mrl_hist_shared_t hist;                 // history of all sessions
+#endif
+
+// worker pool (jobs queue and done list are protected by mutex)
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  job_t *head, *tail;  // jobs queue
+  job_t *done;         // executed jobs (order is restored by session)
+  bool stop;           // stop workers
+  int efd;             // eventfd to wake up I/O thread
+  int num;             // number of workers (0 - execute by I/O thread)
+  pthread_t thread[WORKERS_MAX];
+} pool = {
+  PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+  NULL, NULL, NULL, false, -1, 0
+};
+//-----------------------------------------------------------------------------
+// monotonic time [ms]
+static unsigned now_ms()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned) (ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+//-----------------------------------------------------------------------------
+// monotonic time [us]
+static long long now_us()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+//-----------------------------------------------------------------------------
+static void sig_handler(int sig)
+{
+  stop = 1;
+}
+//-----------------------------------------------------------------------------
+static int set_nonblock(int fd)
+{
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+//-----------------------------------------------------------------------------
+// print callback: put output to session buffer (sent by session_flush())
+static void print(void *ctx, const char *str)
+{
+  session_t *s = (session_t*) ctx;
+  int len = strlen(str);
+
+  if (s->txlen + len > TX_LEN && s->txoff != 0)
+  { // move unsent output to begin of buffer
+    memmove(s->tx, s->tx + s->txoff, s->txlen - s->txoff);
+    s->txlen -= s->txoff;
+    s->txoff = 0;
+  }
+
+  if (s->txlen + len > TX_LEN)
+  { // client don't read output: drop it
+    s->close = true;
+    return;
+  }
+
+  memcpy(s->tx + s->txlen, str, len);
+  s->txlen += len;
+}
+//-----------------------------------------------------------------------------
+// print string to session (not by MicroRL)
+static void session_print(session_t *s, const char *str)
+{
+  print((void*) s, str);
+}
+//-----------------------------------------------------------------------------
+// write output buffer (partial write is OK, rest is sent by EPOLLOUT)
+static void session_flush(session_t *s)
+{
+  bool pollout;
+
+  while (s->txoff < s->txlen)
+  {
+    ssize_t n = write(s->fd, s->tx + s->txoff, s->txlen - s->txoff);
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      s->txoff = s->txlen = 0; // connection lost or pty closed
+      if (s->slave < 0) s->close = true;
+      break;
+    }
+    s->txoff += n;
+  }
+
+  if (s->txoff == s->txlen)
+    s->txoff = s->txlen = 0;
+
+  pollout = s->txlen != 0;
+  if (pollout != s->pollout)
+  {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (pollout ? EPOLLOUT : 0);
+    ev.data.ptr = s;
+    epoll_ctl(ep, EPOLL_CTL_MOD, s->fd, &ev);
+    s->pollout = pollout;
+  }
+}
+//-----------------------------------------------------------------------------
+// close session (memory is freed after events batch)
+static void session_close(session_t *s)
+{
+  if (s->fd < 0) return; // already closed
+
+  epoll_ctl(ep, EPOLL_CTL_DEL, s->fd, NULL);
+  close(s->fd);
+  if (s->slave >= 0) close(s->slave);
+  s->fd = -1;
+
+  session_num--;
+  sessions[s->idx] = sessions[session_num];
+  sessions[s->idx]->idx = s->idx;
+
+  s->next = closed;
+  closed = s;
+}
+//-----------------------------------------------------------------------------
+// free closed sessions without jobs (or all closed sessions and jobs)
+static void session_free(bool all)
+{
+  session_t **p = &closed;
+
+  while (*p != NULL)
+  {
+    session_t *s = *p;
+    if (s->jobs != 0 && !all)
+    { // wait for jobs executed by workers
+      p = &s->next;
+      continue;
+    }
+
+    while (s->head != NULL)
+    {
+      job_t *job = s->head;
+      s->head = job->snext;
+      free(job);
+    }
+
+    *p = s->next;
+    free(s);
+  }
+}
+//-----------------------------------------------------------------------------
+// put command output to job buffer
+static void job_print(job_t *job, const char *str)
+{
+  int len = strlen(str);
+  if (len > JOB_OUT_LEN - job->outlen)
+    len = JOB_OUT_LEN - job->outlen;
+
+  memcpy(job->out + job->outlen, str, len);
+  job->outlen += len;
+}
+//-----------------------------------------------------------------------------
+static void fn_help(job_t *job, int argc, char * const argv[]);
+//-----------------------------------------------------------------------------
+static void fn_echo(job_t *job, int argc, char * const argv[])
+{
+  int i;
+  for (i = 1; i < argc; i++)
+  {
+    if (i > 1) job_print(job, " ");
+    job_print(job, argv[i]);
+  }
+  job_print(job, MRL_ENDL);
+}
+//-----------------------------------------------------------------------------
+static void fn_ping(job_t *job, int argc, char * const argv[])
+{
+  job_print(job, "pong" MRL_ENDL);
+}
+//-----------------------------------------------------------------------------
+// statistics (executed by I/O thread, so server state is safe to read)
+static void fn_stat(job_t *job, int argc, char * const argv[])
+{
+  char str[160];
+  snprintf(str, sizeof(str),
+           "sessions: %i (peak %i), keys: %llu, commands: %llu, "
+           "workers: %i" MRL_ENDL,
+           session_num, session_peak, keys, cmds, pool.num);
+  job_print(job, str);
+}
+//-----------------------------------------------------------------------------
+// slow command (like flash erase)
+static void fn_sleep(job_t *job, int argc, char * const argv[])
+{
+  int ms = argc > 1 ? atoi(argv[1]) : 1000;
+  usleep(ms * 1000);
+  job_print(job, "wake up" MRL_ENDL);
+}
+//-----------------------------------------------------------------------------
+static void fn_quit(job_t *job, int argc, char * const argv[])
+{
+  job->quit = true;
+}
+//-----------------------------------------------------------------------------
+// commands table (for execution, 'help' and completion)
+static const cmd_t commands[] = {
+  { "help",  fn_help,  false },
+  { "echo",  fn_echo,  false },
+  { "ping",  fn_ping,  false },
+  { "stat",  fn_stat,  false },
+  { "sleep", fn_sleep, true  },
+  { "quit",  fn_quit,  false },
+  { NULL,    NULL,     false }
+};
+//-----------------------------------------------------------------------------
+static void fn_help(job_t *job, int argc, char * const argv[])
+{
+  int i;
+  job_print(job, "commands:");
+  for (i = 0; commands[i].name != NULL; i++)
+  {
+    job_print(job, " ");
+    job_print(job, commands[i].name);
+  }
+  job_print(job, " (sleep [ms] - slow command)" MRL_ENDL);
+}
+//-----------------------------------------------------------------------------
+// execute command of job (by I/O thread or by worker)
+static void job_run(job_t *job)
+{
+  if (job->cmd != NULL)
+  {
+    job->cmd->fn(job, job->argc, job->argv);
+  }
+  else
+  {
+    job_print(job, "command '");
+    job_print(job, job->argv[0]);
+    job_print(job, "' not found, see 'help'" MRL_ENDL);
+  }
+  job->out[job->outlen] = '\0';
+}
+//-----------------------------------------------------------------------------
+// send output of done jobs to session in order of commands
+// (async - output is not inside 'execute' callback, so command line
+//  is erased before output and restored after)
+static void session_deliver(session_t *s, bool async)
+{
+  bool first = true;
+
+  while (s->head != NULL && s->head->done)
+  {
+    job_t *job = s->head;
+    s->head = job->snext;
+    if (s->head == NULL) s->tail = NULL;
+    s->jobs--;
+
+    if (s->fd >= 0)
+    { // session is not closed
+      if (async && first)
+        session_print(s, "\r\033[K");
+      first = false;
+
+      session_print(s, job->out);
+      if (job->quit && s->slave < 0)
+        s->close = true;
+    }
+
+    free(job);
+  }
+
+  if (async && !first)
+  {
+    if (s->close)
+    {
+      session_flush(s);
+      session_close(s);
+    }
+    else
+    {
+      mrl_refresh(&s->mrl);
+      session_flush(s);
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+// worker thread
+static void *worker(void *arg)
+{
+  uint64_t one = 1;
+
+  pthread_mutex_lock(&pool.lock);
+  while (1)
+  {
+    job_t *job;
+
+    while (!pool.stop && pool.head == NULL)
+      pthread_cond_wait(&pool.cond, &pool.lock);
+    if (pool.stop) break;
+
+    job = pool.head;
+    pool.head = job->next;
+    if (pool.head == NULL) pool.tail = NULL;
+    pthread_mutex_unlock(&pool.lock);
+
+    job_run(job); // session is not touched by worker
+
+    pthread_mutex_lock(&pool.lock);
+    job->next = pool.done;
+    pool.done = job;
+    if (write(pool.efd, &one, sizeof(one)) < 0) {} // wake up I/O thread
+  }
+  pthread_mutex_unlock(&pool.lock);
+
+  return NULL;
+}
+//-----------------------------------------------------------------------------
+// start worker threads (return -1 on error)
+static int pool_start(int num)
+{
+  struct epoll_event ev;
+
+  if (num <= 0) return 0;
+  if (num > WORKERS_MAX) num = WORKERS_MAX;
+
+  pool.efd = eventfd(0, EFD_NONBLOCK);
+  if (pool.efd < 0) return -1;
+
+  ev.events = EPOLLIN;
+  ev.data.ptr = &pool; // done jobs
+  epoll_ctl(ep, EPOLL_CTL_ADD, pool.efd, &ev);
+
+  for (pool.num = 0; pool.num < num; pool.num++)
+    if (pthread_create(&pool.thread[pool.num], NULL, worker, NULL) != 0)
+      break;
+
+  printf("workers: %i\n", pool.num);
+  return pool.num == num ? 0 : -1;
+}
+//-----------------------------------------------------------------------------
+// stop worker threads (queued jobs are not executed)
+static void pool_stop()
+{
+  int i;
+
+  pthread_mutex_lock(&pool.lock);
+  pool.stop = true;
+  pthread_cond_broadcast(&pool.cond);
+  pthread_mutex_unlock(&pool.lock);
+
+  for (i = 0; i < pool.num; i++)
+    pthread_join(pool.thread[i], NULL);
+
+  if (pool.efd >= 0) close(pool.efd);
+}
+//-----------------------------------------------------------------------------
+// handle jobs executed by workers (in I/O thread)
+static void pool_done()
+{
+  uint64_t cnt;
+  job_t *job;
+
+  if (read(pool.efd, &cnt, sizeof(cnt)) < 0) {} // reset eventfd
+
+  pthread_mutex_lock(&pool.lock);
+  job = pool.done;
+  pool.done = NULL;
+  pthread_mutex_unlock(&pool.lock);
+
+  while (job != NULL)
+  {
+    job_t *next = job->next;
+    job->done = true;
+    session_deliver(job->s, true); // may free job
+    job = next;
+  }
+}
+//-----------------------------------------------------------------------------
+// execute callback: copy arguments to job, execute slow command by worker
+static void execute(void *ctx, int argc, char * const argv[])
+{
+  session_t *s = (session_t*) ctx;
+  job_t *job = (job_t*) calloc(1, sizeof(job_t));
+  int i;
+
+  cmds++;
+
+  if (job == NULL)
+  {
+    session_print(s, "out of memory" MRL_ENDL);
+    return;
+  }
+
+  // command line is reused after return, so arguments are copied
+  job->s = s;
+  job->argc = argc;
+  mrl_argv_copy(job->args, sizeof(job->args), job->argv, argc, argv);
+
+  for (i = 0; commands[i].name != NULL; i++)
+    if (strcmp(commands[i].name, argv[0]) == 0)
+      job->cmd = commands + i;
+
+  // output of session jobs is sent in order of commands
+  if (s->tail != NULL) s->tail->snext = job;
+  else                 s->head = job;
+  s->tail = job;
+  s->jobs++;
+
+  if (job->cmd != NULL && job->cmd->slow && pool.num > 0)
+  { // put job to workers queue
+    pthread_mutex_lock(&pool.lock);
+    if (pool.tail != NULL) pool.tail->next = job;
+    else                   pool.head = job;
+    pool.tail = job;
+    pthread_cond_signal(&pool.cond);
+    pthread_mutex_unlock(&pool.lock);
+  }
+  else
+  { // fast command (output is waiting for previous slow commands)
+    job_run(job);
+    job->done = true;
+    session_deliver(s, false);
+  }
+}
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_COMPLETE
+// completion callback (variants are kept in session, not in static array)
+static const char** complete(void *ctx, int argc, char * const argv[])
+{
+  session_t *s = (session_t*) ctx;
+  int i, j = 0;
+
+  if (argc == 1)
+  {
+    for (i = 0; commands[i].name != NULL; i++)
+      if (strstr(commands[i].name, argv[0]) == commands[i].name)
+        s->compl[j++] = commands[i].name;
+  }
+  s->compl[j] = NULL;
+
+  return s->compl;
+}
+#endif // MRL_USE_COMPLETE
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_TICK
+// idle callback: close TCP session without input
+static void idle(void *ctx)
+{
+  session_t *s = (session_t*) ctx;
+  session_print(s, MRL_ENDL "idle timeout" MRL_ENDL);
+  s->close = true;
+}
+#endif // MRL_USE_TICK
+//-----------------------------------------------------------------------------
+// create session for file descriptor (return NULL on error)
+static session_t *session_open(int fd, int slave)
+{
+  struct epoll_event ev;
+  session_t *s;
+
+  if (session_num >= SESSIONS_MAX) return NULL;
+  s = (session_t*) calloc(1, sizeof(session_t));
+  if (s == NULL) return NULL;
+
+  s->fd    = fd;
+  s->slave = slave;
+
+  ev.events = EPOLLIN;
+  ev.data.ptr = s;
+  if (epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev) < 0)
+  {
+    free(s);
+    return NULL;
+  }
+
+  s->idx = session_num++;
+  sessions[s->idx] = s;
+  if (session_num > session_peak) session_peak = session_num;
+
+  mrl_init(&s->mrl, print, s);
+#ifdef MRL_USE_HIST_SHARED
+  mrl_hist_share(&s->mrl, &hist);
+#endif
+  mrl_set_execute_cb(&s->mrl, execute);
+#ifdef MRL_USE_COMPLETE
+  mrl_set_complete_cb(&s->mrl, complete);
+#endif
+#ifdef MRL_USE_TICK
+  if (slave < 0) mrl_set_idle_cb(&s->mrl, idle_ms, idle);
+  mrl_tick(&s->mrl, now_ms());
+#endif
+  mrl_prompt(&s->mrl);
+  session_flush(s);
+
+  return s;
+}
+//-----------------------------------------------------------------------------
+// read input from session (one read() per event for fairness)
+static void session_read(session_t *s)
+{
+  char buf[RX_LEN];
+  int off = 0, n;
+
+  n = read(s->fd, buf, sizeof(buf));
+  if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+    return;
+
+  if (n <= 0)
+  { // connection closed or error
+    if (s->slave < 0) s->close = true;
+    return;
+  }
+
+  keys += n;
+  while (off < n && !s->close)
+  {
+    int len = n - off;
+    int key = mrl_insert_chars(&s->mrl, buf + off, &len);
+    off += len;
+
+    if (key == 4 && s->slave < 0) // Ctrl+D
+      s->close = true;
+  }
+
+  session_flush(s);
+}
+//-----------------------------------------------------------------------------
+// open pty (return session or NULL)
+static session_t *pty_open()
+{
+  struct termios t;
+  session_t *s;
+  int fd, slave;
+
+  fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if (fd < 0) return NULL;
+
+  if (grantpt(fd) < 0 || unlockpt(fd) < 0 ||
+      (slave = open(ptsname(fd), O_RDWR | O_NOCTTY)) < 0)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  // raw mode: line editing is done by MicroRL
+  tcgetattr(slave, &t);
+  cfmakeraw(&t);
+  tcsetattr(slave, TCSANOW, &t);
+
+  s = session_open(fd, slave);
+  if (s == NULL)
+  {
+    close(slave);
+    close(fd);
+    return NULL;
+  }
+
+  printf("pty session: %s\n", ptsname(fd));
+  return s;
+}
+//-----------------------------------------------------------------------------
+// open listen socket on 127.0.0.1:port (return socket or -1)
+static int tcp_listen(int port)
+{
+  struct sockaddr_in addr;
+  int fd, on = 1;
+
+  fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (fd < 0) return -1;
+
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+      listen(fd, 1024) < 0)
+  {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+//-----------------------------------------------------------------------------
+// accept all pending connections
+static void tcp_accept(int lfd)
+{
+  int fd, on = 1;
+
+  while ((fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK)) >= 0)
+  {
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    if (session_open(fd, -1) == NULL)
+      close(fd); // too many sessions
+  }
+}
+//-----------------------------------------------------------------------------
+// CPU time used by process [s]
+static double cpu_time()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+         ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+}
+//-----------------------------------------------------------------------------
+// multi-session server
+static int server(int port, int pty_num, int workers)
+{
+  struct epoll_event ev[EVENTS_MAX];
+  struct epoll_event lev;
+  unsigned tick = now_ms();
+  long long t0 = now_us();
+  double sec, cpu;
+  int lfd, i, n;
+
+  ep = epoll_create1(0);
+  lfd = tcp_listen(port);
+  if (ep < 0 || lfd < 0)
+  {
+    perror("server");
+    return 1;
+  }
+
+  lev.events = EPOLLIN;
+  lev.data.ptr = NULL; // listen socket
+  epoll_ctl(ep, EPOLL_CTL_ADD, lfd, &lev);
+  printf("TCP sessions: 127.0.0.1:%i\n", port);
+
+  if (pool_start(workers) < 0)
+    perror("workers");
+
+  for (i = 0; i < pty_num; i++)
+    if (pty_open() == NULL) perror("pty");
+
+  while (!stop)
+  {
+    n = epoll_wait(ep, ev, EVENTS_MAX, TICK_MS);
+
+    for (i = 0; i < n; i++)
+    {
+      session_t *s = (session_t*) ev[i].data.ptr;
+
+      if (s == NULL)
+      {
+        tcp_accept(lfd);
+        continue;
+      }
+
+      if ((void*) s == (void*) &pool)
+      {
+        pool_done();
+        continue;
+      }
+
+      if (s->fd < 0) continue; // closed by previous event
+
+      if (ev[i].events & EPOLLIN)
+        session_read(s);
+      else if (ev[i].events & (EPOLLERR | EPOLLHUP))
+        s->close = true;
+
+      if (ev[i].events & EPOLLOUT)
+        session_flush(s);
+
+      if (s->close)
+      {
+        session_flush(s); // last chance to send output
+        session_close(s);
+      }
+    }
+
+    if (now_ms() - tick >= TICK_MS)
+    {
+      tick = now_ms();
+      for (i = session_num - 1; i >= 0; i--)
+      {
+        session_t *s = sessions[i];
+#ifdef MRL_USE_TICK
+        mrl_tick(&s->mrl, tick);
+#endif
+        if (s->txlen != 0) session_flush(s);
+        if (s->close)
+        {
+          session_flush(s);
+          session_close(s);
+        }
+      }
+    }
+
+    session_free(false);
+  }
+
+  sec = (now_us() - t0) * 1e-6;
+  cpu = cpu_time();
+  printf("\n%.1f s (CPU %.2f s), sessions: %i (peak %i), "
+         "keys: %llu, commands: %llu\n",
+         sec, cpu, session_num, session_peak, keys, cmds);
+  if (cpu > 0.)
+    printf("per CPU second: %.0f keys, %.0f commands\n",
+           keys / cpu, cmds / cpu);
+
+  pool_stop();
+  for (i = session_num - 1; i >= 0; i--)
+    session_close(sessions[i]);
+  session_free(true);
+  close(lfd);
+  close(ep);
+
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// load generator client (send command, wait 2 lines of answer, repeat)
+typedef struct {
+  int fd;
+  int sent;       // number of sent command chars
+  int lines;      // number of received lines for current command
+  long long t0;   // command start time [us]
+} client_t;
+//-----------------------------------------------------------------------------
+// send next part of command
+static void client_send(client_t *c, int chunk)
+{
+  const char *cmd = LOAD_CMD;
+  int len = strlen(cmd);
+
+  if (c->sent == 0) c->t0 = now_us();
+
+  while (c->sent < len)
+  {
+    int k = len - c->sent < chunk ? len - c->sent : chunk;
+    ssize_t n = write(c->fd, cmd + c->sent, k);
+    if (n <= 0) break; // EAGAIN: wait EPOLLOUT
+    c->sent += n;
+  }
+}
+//-----------------------------------------------------------------------------
+static int load(int port, int num, int dur, int chunk)
+{
+  struct epoll_event ev[EVENTS_MAX];
+  struct sockaddr_in addr;
+  client_t *clients;
+  unsigned long long done = 0;
+  long long lat = 0, t0, t1;
+  int i, n, on = 1, len = strlen(LOAD_CMD);
+
+  ep = epoll_create1(0);
+  clients = (client_t*) calloc(num, sizeof(client_t));
+  if (ep < 0 || clients == NULL) return 1;
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  for (i = 0; i < num; i++)
+  {
+    struct epoll_event e;
+    client_t *c = clients + i;
+
+    c->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (c->fd < 0 || connect(c->fd, (struct sockaddr*) &addr,
+                             sizeof(addr)) < 0)
+    {
+      perror("connect");
+      return 1;
+    }
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    set_nonblock(c->fd);
+
+    e.events = EPOLLIN | EPOLLOUT;
+    e.data.ptr = c;
+    epoll_ctl(ep, EPOLL_CTL_ADD, c->fd, &e);
+  }
+
+  t0 = now_us();
+  while (!stop && (t1 = now_us()) - t0 < dur * 1000000LL)
+  {
+    n = epoll_wait(ep, ev, EVENTS_MAX, TICK_MS);
+
+    for (i = 0; i < n; i++)
+    {
+      client_t *c = (client_t*) ev[i].data.ptr;
+
+      if (ev[i].events & EPOLLIN)
+      {
+        char buf[RX_LEN];
+        ssize_t k = read(c->fd, buf, sizeof(buf));
+        if (k <= 0)
+        {
+          printf("session closed by server\n");
+          stop = 1;
+          break;
+        }
+
+        while (k-- > 0)
+          if (buf[k] == '\n' && ++c->lines == 2)
+          { // answer received
+            lat += now_us() - c->t0;
+            done++;
+            c->lines = c->sent = 0;
+          }
+      }
+
+      if (c->sent < len)
+        client_send(c, chunk);
+    }
+  }
+
+  t1 = now_us() - t0;
+  printf("sessions: %i, %.1f s, commands: %llu\n", num, t1 * 1e-6, done);
+  if (done)
+    printf("%.0f commands/s, %.0f keys/s, latency %.0f us\n",
+           done * 1e6 / t1, done * len * 1e6 / t1, (double) lat / done);
+
+  for (i = 0; i < num; i++)
+    close(clients[i].fd);
+  free(clients);
+  close(ep);
+
+  return 0;
+}
+//-----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  int port = PORT_DEFAULT, pty_num = 1, num = 100, dur = 10, chunk = 1024;
+  int workers = 0;
+  bool client = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "lp:n:t:w:c:d:k:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'l': client  = true;               break;
+      case 'p': port    = atoi(optarg);       break;
+      case 'n': pty_num = atoi(optarg);       break;
+      case 't': idle_ms = atoi(optarg) * 1000; break;
+      case 'w': workers = atoi(optarg);       break;
+      case 'c': num     = atoi(optarg);       break;
+      case 'd': dur     = atoi(optarg);       break;
+      case 'k': chunk   = atoi(optarg);       break;
+      default:
+        fprintf(stderr,
+          "server:         %s [-p port] [-n ptys] [-t idle_sec] [-w workers]\n"
+          "load generator: %s -l [-p port] [-c sessions] [-d sec] "
+          "[-k keys_per_write]\n", argv[0], argv[0]);
+        return 1;
+    }
+  }
+  if (chunk < 1) chunk = 1;
+
+  setvbuf(stdout, NULL, _IOLBF, 0); // show pty names at once
+  signal(SIGINT, sig_handler);
+  signal(SIGPIPE, SIG_IGN);
+
+  return client ? load(port, num, dur, chunk) : server(port, pty_num, workers);
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "mrl_test5.c" file ***/
+
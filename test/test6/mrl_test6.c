@@ -0,0 +1,227 @@
+/*
+ * MicroRL library test unit #6 (non-interactive, history compression ratio)
+ * File "mrl_test6.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h>
+#include <stdio.h>
+#include "mrl.h"
+//-----------------------------------------------------------------------------
+// MicroRL object
+static mrl_t mrl;
+
+// number of failed checks
+static int errors = 0;
+//-----------------------------------------------------------------------------
+// recorded sessions of embedded device console
+static const char *session_flash[] = {
+  "help", "flash info", "flash erase", "flash erase full", "flash page 12",
+  "flash page 13", "flash read 0x08000000 256", "flash read 0x08000100 256",
+  "flash write 0x08000000 deadbeef", "flash write 0x08000004 cafebabe",
+  "flash verify 0x08000000 8", "flash page 12", "flash page 14",
+  "flash erase sector 3", "flash erase sector 4", "flash erase sector 5",
+  "flash read 0x08010000 64", "flash read 0x08010040 64",
+  "flash read 0x08010080 64", "flash lock", "flash unlock", "flash info",
+  "flash write 0x08010000 01020304", "flash write 0x08010004 05060708",
+  "flash verify 0x08010000 8", "flash crc 0x08000000 65536", "flash lock",
+  "flash unlock", "flash erase sector 6", "flash erase sector 7",
+  "flash write 0x08020000 11223344", "flash write 0x08020004 55667788",
+  "flash write 0x08020008 99aabbcc", "flash read 0x08020000 16",
+  "flash verify 0x08020000 12", "flash crc 0x08020000 12", "flash page 64",
+  "flash page 65", "flash page 66", "flash read 0x08040000 128",
+  "flash read 0x08040080 128", "flash erase sector 8", "flash info",
+  "flash read 0x08040000 128", "flash write 0x08040000 0badf00d",
+  "flash verify 0x08040000 4", "flash crc 0x08000000 65536",
+  "flash crc 0x08010000 65536", "flash crc 0x08020000 65536", "flash lock",
+  "reset", "flash info", "flash crc 0x08000000 65536", NULL };
+
+static const char *session_gpio[] = {
+  "gpio mode PA5 out", "gpio set PA5 1", "gpio set PA5 0", "gpio get PA5",
+  "gpio mode PA6 in", "gpio get PA6", "gpio pull PA6 up", "gpio get PA6",
+  "gpio mode PB0 analog", "adc read 8", "adc read 8", "adc read 9",
+  "adc config 8 sample 480", "adc read 8", "adc config 9 sample 480",
+  "adc read 9", "gpio set PA5 1", "pwm start 1 1000 50", "pwm duty 1 25",
+  "pwm duty 1 75", "pwm duty 1 90", "pwm stop 1", "gpio set PA5 0",
+  "gpio mode PC13 out", "gpio set PC13 1", "gpio set PC13 0",
+  "gpio toggle PC13", "gpio toggle PC13", "adc read 8", "pwm start 2 500 10",
+  "pwm duty 2 20", "pwm duty 2 30", "pwm stop 2", "gpio mode PB1 analog",
+  "adc config 9 sample 56", "adc read 9", "adc read 9 avg 16",
+  "adc read 8 avg 16", "adc read 8 avg 64", "adc calibrate", "adc read 8",
+  "adc read 9", "gpio mode PA7 out", "gpio set PA7 1", "gpio set PA7 0",
+  "gpio mode PA8 af 1", "pwm start 1 20000 50", "pwm duty 1 10",
+  "pwm duty 1 20", "pwm duty 1 40", "pwm duty 1 80", "pwm stop 1",
+  "gpio mode PA8 in", "gpio get PA8", "gpio pull PA8 down", "gpio get PA8",
+  "gpio pull PA8 none", "adc read 8 avg 64", "adc read 9 avg 64", NULL };
+
+static const char *session_net[] = {
+  "net show", "net ip 192.168.1.10", "net mask 255.255.255.0",
+  "net gw 192.168.1.1", "net dns 192.168.1.1", "net up", "net show",
+  "ping 192.168.1.1", "ping 192.168.1.1 -c 10", "ping 192.168.1.20",
+  "net down", "net ip 192.168.1.11", "net up", "ping 192.168.1.1",
+  "net stat", "net stat reset", "net stat", "tftp get 192.168.1.2 fw.bin",
+  "tftp get 192.168.1.2 fw_v2.bin", "fw check fw_v2.bin", "fw update",
+  "net show", "net dhcp on", "net up", "net show", "ping 8.8.8.8",
+  "net dhcp off", "net ip 192.168.1.12", "net up", "net show",
+  "ping 192.168.1.1 -c 100", "ping 192.168.1.1 -c 100 -s 1400",
+  "ping 192.168.1.1 -c 100 -s 64", "net stat", "net stat reset",
+  "tftp put 192.168.1.2 log.txt", "tftp put 192.168.1.2 log_old.txt",
+  "tftp put 192.168.1.2 crash.dump", "net mtu 1400", "net mtu 1500",
+  "net show", "net route add 10.0.0.0/8 192.168.1.254",
+  "net route add 172.16.0.0/12 192.168.1.254", "net route show",
+  "net route del 172.16.0.0/12", "net route show", "ping 10.0.0.1",
+  "ping 10.0.0.2", "ping 10.0.0.3", "net stat", "net down", NULL };
+
+static const struct {
+  const char *name;
+  const char **lines;
+} sessions[] = {
+  { "flash", session_flash },
+  { "gpio/adc/pwm", session_gpio },
+  { "network", session_net },
+  { NULL, NULL }
+};
+//-----------------------------------------------------------------------------
+// print callback for MicroRL library (no output)
+static void print(void *ctx, const char *str)
+{
+}
+//-----------------------------------------------------------------------------
+// put keys to MicroRL
+static void put(const char *keys)
+{
+  while (*keys != '\0')
+    mrl_insert_char(&mrl, *keys++);
+}
+//-----------------------------------------------------------------------------
+// check condition and print result
+static void check(const char *name, int ok)
+{
+  printf("%s: %s\r\n", ok ? "OK  " : "FAIL", name);
+  if (!ok) errors++;
+}
+//-----------------------------------------------------------------------------
+// number of newest lines which fit to not coded ring buffer
+// (line + '\0', one char of ring buffer is always free)
+static int plain_lines(const char **lines, int n)
+{
+  int used = 0, num = 0;
+
+  while (n-- > 0)
+  {
+    if (n > 0 && strcmp(lines[n], lines[n - 1]) == 0)
+      continue; // repeated line is not saved
+    used += strlen(lines[n]) + 1;
+    if (used > MRL_RING_HISTORY_LEN - 1) break;
+    num++;
+  }
+
+  return num;
+}
+//-----------------------------------------------------------------------------
+// execute all lines of session and recall them by UP
+// (return number of lines in history, -1 if recalled line is wrong)
+static int hist_lines(const char **lines, int n)
+{
+  int i, num = 0;
+
+  mrl_init(&mrl, print, NULL);
+  for (i = 0; i < n; i++)
+  {
+    put(lines[i]);
+    put("\r");
+  }
+
+  i = n;
+  while (1)
+  {
+    put("\020"); // UP
+    if (mrl.cmdlen == 0) break; // empty history
+    if (i < n && strcmp(mrl.cmdline, lines[i]) == 0)
+      break; // UP at oldest line
+
+    while (--i > 0 && strcmp(lines[i], lines[i - 1]) == 0);
+    if (i < 0 || strcmp(mrl.cmdline, lines[i]) != 0)
+      return -1;
+    num++;
+  }
+
+  return num;
+}
+//-----------------------------------------------------------------------------
+// history lines in ring buffer with and without front coding
+static void test_ratio()
+{
+  int i, plain_sum = 0, sum = 0;
+
+  printf("history of %i bytes:\r\n"
+         "  %-16s %7s %7s %7s %7s\r\n", MRL_RING_HISTORY_LEN,
+         "session", "lines", "plain", "stored", "ratio");
+
+  for (i = 0; sessions[i].name != NULL; i++)
+  {
+    int n = 0, plain, num;
+    char name[64];
+
+    while (sessions[i].lines[n] != NULL) n++;
+
+    plain = plain_lines(sessions[i].lines, n);
+    num   = hist_lines(sessions[i].lines, n);
+    printf("  %-16s %7i %7i %7i %7.2f\r\n", sessions[i].name, n, plain, num,
+           (double) num / plain);
+
+    sprintf(name, "%s: recalled lines", sessions[i].name);
+    check(name, num >= 0);
+    plain_sum += plain;
+    sum += num;
+  }
+
+  // all sessions (each is started from empty history)
+  printf("  %-16s %7s %7i %7i %7.2f\r\n", "total", "", plain_sum, sum,
+         (double) sum / plain_sum);
+#ifdef MRL_USE_HIST_FRONT
+  check("front-coded history hold 1.4 times more lines",
+        sum * 5 >= plain_sum * 7);
+#else
+  check("plain history", sum == plain_sum);
+#endif // MRL_USE_HIST_FRONT
+}
+//-----------------------------------------------------------------------------
+#ifdef MRL_USE_HIST_PREFIX
+// UP with prefix decode only matched lines
+static void test_prefix()
+{
+  int n = 0, i;
+  while (session_net[n] != NULL) n++;
+
+  printf("prefix history navigation:\r\n");
+
+  hist_lines(session_net, n);
+  for (i = 0; i < n && mrl.cmdlen != 0; i++)
+    put("\016"); // DOWN
+  check("DOWN return to empty line", mrl.cmdlen == 0);
+
+  put("tftp\020");
+  check("UP with prefix",
+        strcmp(mrl.cmdline, "tftp put 192.168.1.2 crash.dump") == 0);
+  put("\020");
+  check("UP with prefix (older)",
+        strcmp(mrl.cmdline, "tftp put 192.168.1.2 log_old.txt") == 0);
+  put("\016\016");
+  check("DOWN to edited line", strcmp(mrl.cmdline, "tftp") == 0);
+}
+#endif // MRL_USE_HIST_PREFIX
+//-----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  test_ratio();
+#ifdef MRL_USE_HIST_PREFIX
+  test_prefix();
+#endif
+
+  printf("%s (%i errors)\r\n", errors ? "FAILED" : "PASSED", errors);
+  return errors ? 1 : 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "mrl_test6.c" file ***/
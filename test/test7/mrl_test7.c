@@ -0,0 +1,238 @@
+/*
+ * MicroRL library test unit #7 (non-interactive, shared history)
+ * File "mrl_test7.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "mrl.h"
+//-----------------------------------------------------------------------------
+#define WRITERS 2   // number of threads which save lines
+#define READERS 4   // number of threads which recall lines
+#define RUN_MS  300 // time of threads test [ms]
+//-----------------------------------------------------------------------------
+// number of failed checks
+static int errors = 0;
+//-----------------------------------------------------------------------------
+// print callback for MicroRL library (no output)
+static void print(void *ctx, const char *str)
+{
+}
+//-----------------------------------------------------------------------------
+// put keys to MicroRL object
+static void put(mrl_t *mrl, const char *keys)
+{
+  while (*keys != '\0')
+    mrl_insert_char(mrl, *keys++);
+}
+//-----------------------------------------------------------------------------
+// check condition and print result
+static void check(const char *name, int ok)
+{
+  printf("%s: %s\r\n", ok ? "OK  " : "FAIL", name);
+  if (!ok) errors++;
+}
+//-----------------------------------------------------------------------------
+// sessions see lines of each other, each session has own cursor
+static void test_sessions()
+{
+  static mrl_hist_shared_t hist, other;
+  static mrl_t a, b, c;
+  char cmd[16], old[MRL_COMMAND_LINE_LEN];
+  int i;
+
+  printf("shared history (%i bytes, %i bytes per session):\r\n",
+         (int) sizeof(mrl_hist_shared_t), (int) sizeof(mrl_hist_t));
+
+  mrl_init(&a, print, NULL);
+  mrl_init(&b, print, NULL);
+  mrl_init(&c, print, NULL);
+  put(&a, "init\r\020");
+  check("history is off after init", a.cmdlen == 0);
+  mrl_hist_share(&a, &hist);
+  mrl_hist_share(&b, &hist);
+  mrl_hist_share(&c, &other);
+
+  put(&a, "flash erase\r");
+  put(&b, "\020"); // UP
+  check("line of session A is seen in session B",
+        strcmp(b.cmdline, "flash erase") == 0);
+  put(&b, "\016"); // DOWN
+  check("DOWN return to empty line", b.cmdlen == 0);
+
+  put(&c, "\020");
+  check("other shared history is empty", c.cmdlen == 0);
+
+  put(&a, "one\rtwo\rthree\r");
+  put(&b, "\020\020");
+  check("UP in session B", strcmp(b.cmdline, "two") == 0);
+  put(&a, "four\r");
+  put(&b, "\020");
+  check("cursor is kept after line of session A",
+        strcmp(b.cmdline, "one") == 0);
+  put(&b, "\016\016\016");
+  check("DOWN to newest line of session A",
+        strcmp(b.cmdline, "four") == 0);
+  put(&b, "\016");
+  check("DOWN to empty line", b.cmdlen == 0);
+
+  put(&b, "t\020");
+  check("prefix search in shared history", strcmp(b.cmdline, "three") == 0);
+  put(&b, "\020");
+  check("prefix search (older)", strcmp(b.cmdline, "two") == 0);
+  put(&b, "\016\016\016");
+  check("DOWN to edited line", strcmp(b.cmdline, "t") == 0);
+  put(&b, "\025\r"); // Ctrl+U, ENTER (go out from history)
+
+  // current line of session B is deleted by lines of session A
+  put(&b, "\033[5~"); // PgUp (oldest line)
+  strcpy(old, b.cmdline);
+  for (i = 0; i < MRL_RING_HISTORY_LEN / 4; i++)
+  {
+    sprintf(cmd, "cmd%i\r", i);
+    put(&a, cmd);
+  }
+  put(&b, "\020");
+  check("UP after deleted line do nothing", strcmp(b.cmdline, old) == 0);
+  put(&b, "\016");
+  put(&a, "\033[5~"); // oldest line of shared history
+  check("DOWN after deleted line show oldest line",
+        strcmp(b.cmdline, a.cmdline) == 0 && strcmp(b.cmdline, old) != 0);
+
+  mrl_hist_share(&c, NULL);
+  put(&c, "off\r\020");
+  check("history is off", c.cmdlen == 0);
+}
+//-----------------------------------------------------------------------------
+// lines of writers (one line is checked without other lines)
+static mrl_hist_shared_t hist;
+static volatile bool stop = false;
+static unsigned saved = 0, recalled = 0, bad = 0;
+static unsigned chars = 0; // number of chars of saved lines (with '\0')
+//-----------------------------------------------------------------------------
+// hash of line number
+static unsigned line_hash(int id, unsigned n)
+{
+  return (n * 2654435761u) ^ (unsigned) id;
+}
+//-----------------------------------------------------------------------------
+// make line: "w<id> <n> <n % 32 dots> <hash>"
+static void line_make(char *str, int id, unsigned n)
+{
+  static const char dots[] = "................................";
+  sprintf(str, "w%i %u %.*s %x", id, n, (int) (n % 32), dots,
+          line_hash(id, n));
+}
+//-----------------------------------------------------------------------------
+// check recalled line (it may be empty string only)
+static bool line_check(const char *str)
+{
+  char line[MRL_COMMAND_LINE_LEN];
+  int id;
+  unsigned n;
+
+  if (*str == '\0') return true;
+  if (sscanf(str, "w%i %u", &id, &n) != 2) return false;
+  line_make(line, id, n);
+  return strcmp(str, line) == 0;
+}
+//-----------------------------------------------------------------------------
+// writer thread: save lines by ENTER
+static void *writer(void *arg)
+{
+  static mrl_t mrl[WRITERS];
+  int id = (int) (long) arg;
+  mrl_t *w = mrl + id;
+  char line[MRL_COMMAND_LINE_LEN];
+  unsigned n = 0, len = 0;
+
+  mrl_init(w, print, NULL);
+  mrl_hist_share(w, &hist);
+
+  while (!stop)
+  {
+    line_make(line, id, n++);
+    put(w, line);
+    put(w, "\r");
+    len += strlen(line) + 1;
+  }
+
+  __atomic_add_fetch(&saved, n, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&chars, len, __ATOMIC_RELAXED);
+  return NULL;
+}
+//-----------------------------------------------------------------------------
+// reader thread: UP/DOWN/PgUp/PgDn and check lines
+static void *reader(void *arg)
+{
+  static mrl_t mrl[READERS];
+  static const char *keys[] = {
+    "\020", "\020", "\020", "\016", "\033[5~", "\033[6~", "\016\016" };
+  int id = (int) (long) arg;
+  mrl_t *r = mrl + id;
+  unsigned n = 0, fail = 0, rnd = id + 1;
+
+  mrl_init(r, print, NULL);
+  mrl_hist_share(r, &hist);
+
+  while (!stop)
+  {
+    rnd = rnd * 1103515245 + 12345;
+    put(r, keys[(rnd >> 16) % (sizeof(keys) / sizeof(keys[0]))]);
+    if (!line_check(r->cmdline))
+    {
+      if (fail++ == 0)
+        printf("  reader %i: bad line '%s'\r\n", id, r->cmdline);
+    }
+    n++;
+  }
+
+  __atomic_add_fetch(&recalled, n, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&bad, fail, __ATOMIC_RELAXED);
+  return NULL;
+}
+//-----------------------------------------------------------------------------
+// writers and readers threads use one shared history at the same time
+static void test_threads()
+{
+  pthread_t thread[WRITERS + READERS];
+  long i;
+
+  printf("shared history: %i writers, %i readers, %i ms:\r\n",
+         WRITERS, READERS, RUN_MS);
+
+  for (i = 0; i < WRITERS; i++)
+    pthread_create(thread + i, NULL, writer, (void*) i);
+  for (i = 0; i < READERS; i++)
+    pthread_create(thread + WRITERS + i, NULL, reader, (void*) i);
+
+  usleep(RUN_MS * 1000);
+  stop = true;
+
+  for (i = 0; i < WRITERS + READERS; i++)
+    pthread_join(thread[i], NULL);
+
+  printf("  lines: %u, recalls: %u, bad lines: %u\r\n", saved, recalled, bad);
+  check("writers saved lines", saved > 0);
+  check("readers recalled lines", recalled > 0);
+  check("no broken lines", bad == 0);
+  check("no lost lines (all lines appended)", hist.end == chars);
+
+  check("shared history is released",
+        (hist.seq & 1) == 0 && hist.end - hist.begin <= MRL_RING_HISTORY_LEN);
+}
+//-----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  test_sessions();
+  test_threads();
+
+  printf("%s (%i errors)\r\n", errors ? "FAILED" : "PASSED", errors);
+  return errors ? 1 : 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "mrl_test7.c" file ***/
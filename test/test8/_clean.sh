@@ -0,0 +1,4 @@
+#!/bin/sh
+
+make clean
+
@@ -0,0 +1,144 @@
+/*
+ * MicroRL library test unit #8 (non-interactive, menu completion)
+ * File "mrl_test8.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include <string.h>
+#include <stdio.h>
+#include "mrl.h"
+//-----------------------------------------------------------------------------
+// MicroRL object
+static mrl_t mrl;
+
+// output counters
+static int bytes = 0; // number of printed bytes
+static int compl_calls = 0; // number of completion callback calls
+
+// number of failed checks
+static int errors = 0;
+//-----------------------------------------------------------------------------
+// print callback for MicroRL library (count output only)
+static void print(void *ctx, const char *str)
+{
+  bytes += strlen(str);
+}
+//-----------------------------------------------------------------------------
+// put keys to MicroRL (return number of output bytes)
+static int put(const char *keys)
+{
+  bytes = 0;
+  while (*keys != '\0')
+    mrl_insert_char(&mrl, *keys++);
+  mrl_flush(&mrl);
+  return bytes;
+}
+//-----------------------------------------------------------------------------
+// check condition and print result
+static void check(const char *name, int ok)
+{
+  printf("%s: %s\r\n", ok ? "OK  " : "FAIL", name);
+  if (!ok) errors++;
+}
+//-----------------------------------------------------------------------------
+// streaming completion callback: commands and interfaces "eth0".."eth99"
+static void complete(void *ctx, int argc, char * const argv[],
+                     mrl_compl_t *compl)
+{
+  static const char *cmds[] = { "down", "reset", "set", "setup", "up", NULL };
+  const char *last = argv[argc - 1];
+  int i, len = strlen(last);
+  char name[16];
+
+  compl_calls++;
+  if (argc == 1)
+  {
+    for (i = 0; cmds[i] != NULL; i++)
+      if (strncmp(cmds[i], last, len) == 0)
+        mrl_compl_add(compl, cmds[i]);
+    return;
+  }
+
+  for (i = 0; i < 100; i++)
+  {
+    sprintf(name, "eth%i", i);
+    if (strncmp(name, last, len) == 0)
+      mrl_compl_add(compl, name);
+  }
+}
+//-----------------------------------------------------------------------------
+// TAB and Shift+TAB cycle variants without callback calls
+static void test_menu()
+{
+  int out;
+
+  printf("menu completion:\r\n");
+  mrl_init(&mrl, print, NULL);
+  mrl_set_compl_cb(&mrl, complete);
+
+  put("se\t");
+  check("first variant", strcmp(mrl.cmdline, "set") == 0 &&
+        mrl.cursor == mrl.cmdlen && compl_calls == 1);
+  out = put("\t");
+  check("next variant", strcmp(mrl.cmdline, "setup") == 0);
+  check("only changed part of token printed", out <= 3 + 2); // ESC[K "up"
+  out = put("\t");
+  check("wrap to first variant", strcmp(mrl.cmdline, "set") == 0);
+  printf("  'setup' -> 'set': %i bytes\r\n", out);
+  put("\033[Z");
+  check("Shift+TAB give previous variant", strcmp(mrl.cmdline, "setup") == 0);
+  put("\033[Z\033[Z");
+  check("Shift+TAB wrap to last variant", strcmp(mrl.cmdline, "setup") == 0);
+  check("callback is not called again", compl_calls == 1);
+
+  put(" eth1\t");
+  check("menu stop by other key", strcmp(mrl.cmdline, "setup eth1") == 0 &&
+        compl_calls == 2);
+  put("\t\t");
+  check("variants of second token",
+        strcmp(mrl.cmdline, "setup eth11") == 0 && compl_calls == 2);
+  out = put("\t\t\t\t\t\t\t\t\t");
+  check("wrap to first variant of token",
+        strcmp(mrl.cmdline, "setup eth1") == 0 && compl_calls == 2);
+  printf("  9 TABs: %i bytes\r\n", out);
+
+  put("\025u\t");
+  check("one variant (no menu)", strcmp(mrl.cmdline, "up ") == 0 &&
+        compl_calls == 3);
+  put("\t");
+  check("list of variants if cache is full",
+        strcmp(mrl.cmdline, "up eth") == 0 && compl_calls == 5);
+
+  put("\025se\t\r");
+  compl_calls = 0;
+  put("se\t");
+  check("ENTER stop menu", strcmp(mrl.cmdline, "set") == 0 &&
+        compl_calls == 1);
+  put("\025");
+
+  compl_calls = 0;
+  put("\t"); // TAB at begin of line
+  check("TAB at begin of line complete empty token", compl_calls == 1 &&
+        strcmp(mrl.cmdline, "down") == 0);
+  put("\025");
+
+  put("setup eth1\t\t"); // menu of "eth1*" variants
+  compl_calls = 0;
+  mrl_prompt(&mrl);
+  put("\t");
+  check("mrl_prompt() stop menu and drop cache", compl_calls == 1 &&
+        strcmp(mrl.cmdline, "down") == 0 &&
+        mrl.cmdlen == 4 && mrl.cursor == 4);
+  put("\025");
+}
+//-----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+  test_menu();
+
+  printf("%s (%i errors)\r\n", errors ? "FAILED" : "PASSED", errors);
+  return errors ? 1 : 0;
+}
+//-----------------------------------------------------------------------------
+
+/*** end of "mrl_test8.c" file ***/
@@ -0,0 +1,10 @@
+/*
+ * MicroRL library test unit #9 (test #4 with output and shadow buffers)
+ * File "mrl_test9.c"
+ */
+
+//-----------------------------------------------------------------------------
+#include "../test4/mrl_test4.c"
+//-----------------------------------------------------------------------------
+
+/*** end of "mrl_test9.c" file ***/